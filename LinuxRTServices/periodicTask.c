@@ -22,6 +22,22 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <math.h>
+#include <sys/utsname.h>
+
+#include "hdrHist.h"
+#include "rtLog.h"
+#include "actTrace.h"
+#include "integKernel.h"
+#include "loadCal.h"
+#include "forkJoin.h"
+#include "taskStats.h"
+#include "overrun.h"
+#include "hybridSleep.h"
+#include "tsClock.h"
+#include "rtPrep.h"
+#include "schedDl.h"
+#include "interference.h"
+#include "cpuTopo.h"
 
 
 /* ***********************************************
@@ -37,19 +53,55 @@
 #define BOOT_ITER 10				// Number of activations for warm-up
                                     // There is an initial transient in which first activations
                                     // often have an irregular behaviour (cache issues, ..)
+#define BOOT_ITER_PREPARED 2		// Warm-up when memory is locked and prefaulted (see rtPrep.h)
+
+#define HIST_PRECISION_BITS HDR_DEFAULT_PRECISION_BITS	// Resolution of the latency histograms
+
+#define DEFAULT_SUBINTERVAL 200000	// Heavy_Work load when no execution time is given (-C)
 
 
 
 int periodo = 0;
-cpu_set_t cpuset;
+cpu_set_t cpuset;					// CPUs of main and the other non-RT threads (housekeeping)
+cpu_set_t thread1_cpus;				// CPUs of Thread_1 (-A option, or picked from the topology)
+struct cpuTopo topo;				// CPU topology, for the placement
+
+struct hdrHist jitter_hist;			// Inter-arrival jitter distribution of Thread_1
+struct rtLog thread1_log;			// Deferred output of Thread_1 (no printf in the periodic loop)
+struct actTrace thread1_trace;		// Activation trace of Thread_1 (-T option)
+struct loadCal thread1_load;		// Heavy_Work load of Thread_1 (-C option)
+struct taskStats thread1_stats;		// Release latency, execution/response times and deadline misses of Thread_1
+uint64_t deadline_ns = 0;			// Relative deadline of Thread_1 (-D option, 0: implicit, D=T)
+struct overrunCtl thread1_ovr;		// Overrun policy and counters of Thread_1
+enum overrunPolicy overrun_policy = OVERRUN_CATCHUP;	// -O option
+struct hybridSleep thread1_sleep;	// Sleep-then-spin wakeup of Thread_1 (-S option)
+int hybrid = 0;						// -S given
+int64_t hybrid_guard_ns = 0;		// -S guard (0: auto tuned)
+int use_tsc = 1;					// Timestamps from the TSC, when invariant (-K disables)
+int prepare = 1;					// Lock/prefault memory and hold cpu_dma_latency (-M disables)
+int boot_iter = BOOT_ITER;			// Activations for warm-up
+uint64_t dl_runtime_ns = 0;			// SCHED_DEADLINE runtime (-E option, 0: SCHED_FIFO)
+uint64_t dl_overbudget = 0;			// SCHED_DEADLINE jobs that used more CPU time than the runtime (throttled)
+struct rtFaults faults_start, faults_boot, faults_end;	// Page faults of Thread_1 at start, after warm-up, at exit
+int run_cpu = 0;					// First CPU of Thread_1
+unsigned int duration_s = 0;		// Run time, then stop as with CTRL+C (-d option, 0: until stopped)
+char *json_file = NULL;				// Results as JSON, with the histograms (-J option)
+char *csv_file = NULL;				// Results as a CSV summary row, appended (-V option)
+char scenario[256];					// Interference active during the run (-I options)
+volatile sig_atomic_t stop = 0;			// Set by CTRL+C to terminate the periodic loop
 
 
 /* ***********************************************
 * Prototypes
 * ***********************************************/
 void Heavy_Work(unsigned char FirstFlag);
+void catch_signal(int sig);
 struct  timespec TsAdd(struct  timespec  ts1, struct  timespec  ts2);
 struct  timespec TsSub(struct  timespec  ts1, struct  timespec  ts2);
+int64_t TsToNs(struct  timespec  ts);
+struct  timespec NsToTs(int64_t ns);
+void Report_Json(const char *path, const char *name, int prio, uint64_t period_ns);
+void Report_Csv(const char *path, const char *name, int prio, uint64_t period_ns);
 
 
 /* *************************
@@ -61,7 +113,10 @@ void * Thread_1_code(void *arg)
 	
     /* Timespec variables to manage time */
 	struct timespec ts, // thread next activation time (absolute)
+			tr, 		// release time of current thread activation (absolute)
 			ta, 		// activation time of current thread activation (absolute)
+			tws, twe, 	// work start/end of current thread activation
+			tcs, tce,	// CPU time of the thread at work start/end (SCHED_DEADLINE mode)
 			tiat, 		// thread inter-arrival time,
 			ta_ant, 	// activation time of last instance (absolute),
 			tp; 		// Thread period
@@ -70,6 +125,9 @@ void * Thread_1_code(void *arg)
 	uint64_t min_iat, max_iat; // Hold the minimum/maximum observed inter arrival time
 	int niter = 0; 	// Activation counter
 	int update; 	// Flag to signal that min/max should be updated
+	uint32_t flags;	// Activation trace flags
+	int64_t missed;	// Releases that passed while the thread was late
+	int64_t latest, lastMissed = 0; // Latest release passed / already accounted (catch-up)
 	
 	/* Set absolute activation time of first instance */
 	if (periodo != 0 ){
@@ -82,27 +140,71 @@ void * Thread_1_code(void *arg)
 	}
 
 	
+	/* SCHED_DEADLINE mode: the CBS releases the thread, every period */
+	if(dl_runtime_ns) {
+		int err = SchedDl_Set(dl_runtime_ns, deadline_ns ? deadline_ns : (uint64_t)TsToNs(tp), TsToNs(tp));
+		if(err) {
+			RtLog_Printf(&thread1_log, "Thread_1: could not switch to SCHED_DEADLINE (error %d)\n", -err);
+			stop = 1;
+			return NULL;
+		}
+	}
+
+	/* Prefault the stack, so that the periodic loop does not page-fault */
+	if(prepare)
+		RtPrep_Stack(RTPREP_STACK_PREFAULT);
+	RtPrep_Faults(&faults_start);
+	faults_boot = faults_start;
+
+	TaskStats_Init(&thread1_stats, deadline_ns ? deadline_ns : (uint64_t)TsToNs(tp));
+	Overrun_Init(&thread1_ovr, overrun_policy, TsToNs(tp), thread1_stats.deadline_ns);
+	HybridSleep_Init(&thread1_sleep, hybrid, hybrid_guard_ns, TsToNs(tp));
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	ts = TsAdd(ts,tp);	
 	
 	/* Periodic jobs ...*/ 
-	while(1) {
+	while(!stop) {
 
 		/* Wait until next cycle */
-		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,&ts,NULL);
-		clock_gettime(CLOCK_MONOTONIC, &ta);		
+		if(dl_runtime_ns) {
+			sched_yield(); // End of job: suspended until the next period
+			TsClock_Gettime(&ta);
+			if(niter == 0) // Nominal releases are counted from the first one
+				ts = ta;
+		} else {
+			HybridSleep_Until(&thread1_sleep, &ts); // clock_nanosleep, optionally followed by polling
+			TsClock_Gettime(&ta); // Same as clock_gettime(CLOCK_MONOTONIC), cheaper with an invariant TSC
+		}
+		tr = ts;
 		ts = TsAdd(ts,tp);		
+
+		/* Overrun handling. With catch-up the missed releases are served by
+		 * the next iterations (only the new ones are counted); otherwise
+		 * they are dropped and the thread continues from the latest one */
+		missed = TsToNs(TsSub(ta, tr)) / TsToNs(tp);
+		if(overrun_policy == OVERRUN_CATCHUP) {
+			latest = TsToNs(tr) + missed * TsToNs(tp);
+			if(latest > lastMissed) {
+				missed = (latest - (lastMissed > TsToNs(tr) ? lastMissed : TsToNs(tr))) / TsToNs(tp);
+				lastMissed = latest;
+			} else
+				missed = 0;
+		} else if(missed) {
+			tr = NsToTs(TsToNs(tr) + missed * TsToNs(tp));
+			ts = TsAdd(tr,tp);
+		}
 		
 		niter++; // Count number of activations
 		
 		/* Compute latency and jitter */		
 		tiat=TsSub(ta,ta_ant);  // Compute time since last activation
-		if(niter == BOOT_ITER) {	// Boot time finished. Init max/min variables	    
+		if(niter == boot_iter) {	// Boot time finished. Init max/min variables	    
+			  RtPrep_Faults(&faults_boot);
 			  min_iat = tiat.tv_nsec;
 		      max_iat = tiat.tv_nsec;
 		      update = 1;
 		} else {
-			if( niter > BOOT_ITER) { 	// Update max/min, if boot time elapsed 	    
+			if( niter > boot_iter) { 	// Update max/min, if boot time elapsed 	    
 				if(tiat.tv_nsec < min_iat) {
 					min_iat = tiat.tv_nsec;
 					update = 1;
@@ -113,22 +215,45 @@ void * Thread_1_code(void *arg)
 				}
 			}
 		}
+		if(niter >= boot_iter) // Jitter distribution: deviation of the inter-arrival time from the period
+			HdrHist_Record(&jitter_hist, llabs(TsToNs(tiat) - TsToNs(tp)));
 		
 		ta_ant = ta; // Update ta_ant
 	
 		  
   		/* Print maximum/minimum inter-arrival time */
 		if(update) {
-		  printf("Task %s inter-arrival time (us): min: %10.3f / max: %10.3f \n\r",(char *) arg, (float)min_iat/1000, (float)max_iat/1000);
+		  RtLog_Printf(&thread1_log, "Task %s inter-arrival time (us): min: %10.3f / max: %10.3f \n\r",(char *) arg, (float)min_iat/1000, (float)max_iat/1000);
 		  update = 0;
 		}
 		
+		/* Abort the job if it can no longer meet its deadline (abort policy) */
+		flags = (missed || TsToNs(TsSub(ta, tr)) >= TsToNs(tp)) ? ACT_TRACE_F_OVERRUN : 0;
+		if(!Overrun_Check(&thread1_ovr, missed, TsToNs(TsSub(ta, tr))))
+			continue;
+
 		/* Do the actual processing */		
+		if(dl_runtime_ns)
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tcs);
+		TsClock_Gettime(&tws);
 		if(niter == 1)
 			Heavy_Work(TRUE); /* For the first activation estimate the execution time */
 		else
 			Heavy_Work(FALSE);		
+		TsClock_Gettime(&twe);
+		if(dl_runtime_ns) { // The kernel only signals throttling on a tick: check the budget too
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tce);
+			if(TsToNs(TsSub(tce, tcs)) > (int64_t)dl_runtime_ns)
+				dl_overbudget++;
+		}
+
+		/* Job accounting: release latency, execution and response times, deadline */
+		if(TaskStats_Record(&thread1_stats, TsToNs(tr), TsToNs(ta), TsToNs(tws), TsToNs(twe)))
+			flags |= ACT_TRACE_F_DEADLINE_MISS;
+		if(ActTrace_Enabled(&thread1_trace))
+			ActTrace_Record(&thread1_trace, TsToNs(tr), TsToNs(ta), TsToNs(tws), TsToNs(twe), flags);
 	}  
+	RtPrep_Faults(&faults_end);
   
     return NULL;
 }
@@ -139,13 +264,88 @@ void * Thread_1_code(void *arg)
 
 int main(int argc, char *argv[])
 {
-	int err;
+	int err, opt;
 	pthread_t threadid;
 	char procname[40]; 
+	char cpulist[256];
+	char *tracefile = NULL;
+	uint64_t tracelen = 0;
+	uint64_t exec_ns = 0;
+	int workerCpus[FJ_MAX_WORKERS], nworkers = 0;
+	uint64_t period_ns;
+	char *intf_specs[INTF_MAX_SPECS + 1];
+	int nintf = 0, i;
+
+	/* Process options */
+	while((opt = getopt(argc, argv, "T:N:C:P:D:O:S:KME:A:d:J:V:I:")) != -1) {
+		switch(opt) {
+			case 'T':	// Activation trace file
+				tracefile = optarg;
+				break;
+			case 'N':	// Activations kept in the trace
+				tracelen = strtoull(optarg, NULL, 0);
+				break;
+			case 'C':	// Heavy_Work execution time (us)
+				exec_ns = strtoull(optarg, NULL, 0) * 1000;
+				break;
+			case 'A':	// CPUs of Thread_1
+				if(CpuTopo_ParseList(optarg, &thread1_cpus) <= 0)
+					argc = 0;
+				break;
+			case 'd':	// Duration (s)
+				duration_s = strtoul(optarg, NULL, 0);
+				break;
+			case 'J':	// JSON results
+				json_file = optarg;
+				break;
+			case 'V':	// CSV results
+				csv_file = optarg;
+				break;
+			case 'I':	// Interference generator, on the CPU of Thread_1 by default
+				intf_specs[nintf++] = optarg;
+				if(nintf > INTF_MAX_SPECS)
+					argc = 0;
+				break;
+			case 'E':	// SCHED_DEADLINE, with this runtime (us)
+				dl_runtime_ns = strtoull(optarg, NULL, 0) * 1000;
+				break;
+			case 'M':	// No memory locking/prefaulting nor cpu_dma_latency request
+				prepare = 0;
+				break;
+			case 'K':	// Timestamps with clock_gettime, even if the TSC is usable
+				use_tsc = 0;
+				break;
+			case 'S':	// Sleep-then-spin wakeup, guard interval (us) or "auto"
+				hybrid = 1;
+				hybrid_guard_ns = strcmp(optarg, "auto") ? strtoll(optarg, NULL, 0) * 1000 : 0;
+				break;
+			case 'O':	// Overrun policy
+				err = Overrun_Parse(optarg);
+				if(err < 0)
+					argc = 0;
+				else
+					overrun_policy = err;
+				break;
+			case 'D':	// Relative deadline (us)
+				deadline_ns = strtoull(optarg, NULL, 0) * 1000;
+				break;
+			case 'P':	// Parallel Heavy_Work, with workers on these CPUs
+				nworkers = ForkJoin_ParseCpus(optarg, workerCpus, FJ_MAX_WORKERS);
+				if(nworkers <= 0)
+					argc = 0;
+				break;
+			default:
+				argc = 0;
+				break;
+		}
+	}
+	argv[optind - 1] = argv[0]; // Drop the options, positional args keep their index
+	argv += optind - 1;
+	argc -= optind - 1;
 
 	/* Process input args */
 	if(argc != 2 && argc !=4) {
-	  printf("Usage: %s PROCNAME, where PROCNAME is a string\n\r ", argv[0]);
+	  printf("Usage: %s [-T TRACEFILE [-N RECORDS]] [-C EXEC_US] [-D DEADLINE_US] [-O catchup|skip|abort] [-S GUARD_US|auto] [-K] [-M] [-E RUNTIME_US] [-P CPULIST] [-A CPULIST] [-I TYPE[:PCT][@CPULIST]]... [-d SECONDS] [-J JSONFILE] [-V CSVFILE] PROCNAME [PRIORITY PERIOD_MS], where PROCNAME is a string\n\r ", argv[0]);
 	  return -1; 
 	}
 
@@ -160,16 +360,110 @@ int main(int argc, char *argv[])
 			return -1;
 		}
 	}
+	period_ns = argc == 4 ? atoi(argv[3]) * 1000000ULL : (uint64_t)PERIOD_S * NS_IN_SEC + PERIOD_NS;
 
 
+	/* Prepare the process: lock and prefault memory, keep the CPUs out of deep C-states */
+	if(prepare) {
+		err = RtPrep_Process(RTPREP_HEAP_RESERVE);
+		if(err)
+			printf("Warning: could not lock memory [%s], keeping %d warm-up activations\n", strerror(-err), BOOT_ITER);
+		else
+			boot_iter = BOOT_ITER_PREPARED;
+		err = RtPrep_DmaLatency(0);
+		if(err)
+			printf("Warning: could not hold /dev/cpu_dma_latency [%s]\n", strerror(-err));
+	}
+
+	printf("Heavy_Work integration kernel: %s\n", IntegKernel_Select());
+	TsClock_Init(use_tsc);
+	printf("Timestamps: %s\n", TsClock_Source());
+	HdrHist_Init(&jitter_hist, HIST_PRECISION_BITS);
+	RtLog_Init(&thread1_log, argv[1]);
+	signal(SIGTERM, catch_signal); // Stop the periodic thread and show statistics
+	signal(SIGINT, catch_signal);
+	signal(SIGALRM, catch_signal); // End of the -d duration
+
+	/* Placement: Thread_1 and the Heavy_Work workers on the CPUs given or
+	 * picked from the topology, the rest of the process on the others */
+	CpuTopo_Read(&topo);
+	if(CPU_COUNT(&thread1_cpus) == 0)
+		CpuTopo_Pick(&topo, &thread1_cpus);
+	else
+		CpuTopo_Assign(&topo, &thread1_cpus);
+	for(run_cpu = 0; !CPU_ISSET(run_cpu, &thread1_cpus); run_cpu++);
 	CPU_ZERO(&cpuset);
-	CPU_SET(0,&cpuset);
+	for(int i = 0; i < nworkers; i++)
+		CPU_SET(workerCpus[i], &cpuset);
+	CpuTopo_Assign(&topo, &cpuset);
+	CpuTopo_Print(&topo, stdout);
+	CpuTopo_Check(&topo, &thread1_cpus, "Thread_1", stdout);
+	if(nworkers > 0)
+		CpuTopo_Check(&topo, &cpuset, "Heavy_Work workers", stdout);
+	CpuTopo_Housekeeping(&topo, &cpuset);
+	printf("Placement: main, logger and the other non-RT threads on CPU %s\n", CpuTopo_ListStr(&cpuset, cpulist, sizeof(cpulist)));
+	if(dl_runtime_ns)
+		printf("Placement: SCHED_DEADLINE, Thread_1 may run on any CPU\n");
 	if(sched_setaffinity(0, sizeof(cpuset), &cpuset)) {
-		printf("\n Lock of process to CPU0 failed!!!");
+		printf("\n Lock of process to the housekeeping CPUs failed!!!");
 		return(1);
 	}
+
+	/* Start the Heavy_Work workers (same priority as Thread_1), if requested */
+	if(nworkers > 0) {
+		err = ForkJoin_Start(workerCpus, nworkers, SCHED_FIFO, argc == 4 ? atoi(argv[2]) : 10);
+		if(err) {
+			printf("\n\r Error creating Heavy_Work workers [%s]", strerror(-err));
+			return -1;
+		}
+		printf("Heavy_Work split over Thread_1 (CPU%d) and %d workers\n", run_cpu, nworkers);
+	}
+
+	/* Calibrate the load, with the kernel the thread will use */
+	if(LoadCal_InitKernel(&thread1_load, nworkers > 0 ? ForkJoin_Kernel : Integ_Kernel, exec_ns, DEFAULT_SUBINTERVAL)) {
+		printf("Usage: invalid execution time\n\r");
+		return -1;
+	}
+	if(exec_ns)
+		printf("Heavy_Work calibrated: %d sub-intervals for %.3f us\n",
+			thread1_load.subInterval, (double)exec_ns / 1000);
 	
 	
+	/* Preallocate and map the trace file, if requested */
+	if(tracefile != NULL) {
+		err = ActTrace_Open(&thread1_trace, tracefile, argv[1], period_ns, tracelen);
+		if(err) {
+			printf("\n\r Error creating trace file %s [%s]", tracefile, strerror(-err));
+			return -1;
+		}
+	}
+
+	/* Start the interference generators, if requested (after -A is known: it is their default CPU) */
+	for(i = 0; i < nintf; i++) {
+		err = Interference_Add(intf_specs[i], run_cpu);
+		if(err) {
+			printf("Usage: invalid interference %s (cpu|cache|syscall|pagefault[:PCT][@CPULIST]) [%s]\n\r",
+				intf_specs[i], strerror(-err));
+			return -1;
+		}
+	}
+	Interference_Describe(scenario, sizeof(scenario));
+	err = Interference_Start();
+	if(err) {
+		printf("\n\r Error starting the interference generators [%s]", strerror(-err));
+		return -1;
+	}
+	if(nintf)
+		printf("Interference: %s\n", scenario);
+
+	/* Start the logger thread, that prints what Thread_1 logs */
+	struct rtLog *logs[] = { &thread1_log };
+	err = RtLogger_Start(logs, 1, stdout);
+	if(err) {
+		printf("\n\r Error creating logger thread [%s]", strerror(-err));
+		return -1;
+	}
+
 	/* Create periodic thread/task */
 	strcpy(procname, argv[1]);
 	if ( argc == 4){
@@ -181,6 +475,7 @@ int main(int argc, char *argv[])
 		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
 		parm.sched_priority = atoi(argv[2]);
 		pthread_attr_setschedparam(&attr, &parm);
+		pthread_attr_setaffinity_np(&attr, sizeof(thread1_cpus), &thread1_cpus);
 		periodo = atoi(argv[3]);
 		err=pthread_create(&threadid, &attr, Thread_1_code, &procname);
 	}
@@ -193,6 +488,7 @@ int main(int argc, char *argv[])
 		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
 		parm.sched_priority = 10;
 		pthread_attr_setschedparam(&attr, &parm);
+		pthread_attr_setaffinity_np(&attr, sizeof(thread1_cpus), &thread1_cpus);
 		err=pthread_create(&threadid,&attr, Thread_1_code, &procname);
 	}
 	
@@ -202,11 +498,30 @@ int main(int argc, char *argv[])
 		printf("\n\r Error creating Thread [%s]", strerror(err));
 		return -1;
 	}
-	else 
-		while(1); // Ok. Thread shall run
+	else if(duration_s) // Ok. Thread shall run
+		alarm(duration_s);
 	
-	/* Last thing that main() should do */
-    pthread_exit(NULL);
+	pthread_join(threadid, NULL);
+	Interference_Stop();
+	ForkJoin_Stop();
+	RtLogger_Stop();
+	ActTrace_Close(&thread1_trace);
+	HdrHist_Print(&jitter_hist, "Inter-arrival jitter", stdout);
+	TaskStats_Print(&thread1_stats, argv[1], stdout);
+	Overrun_Print(&thread1_ovr, argv[1], stdout);
+	if(dl_runtime_ns)
+		printf("%s SCHED_DEADLINE: runtime %.3f us, throttling: %llu signalled by the kernel, %llu jobs over budget\n", argv[1],
+			(double)dl_runtime_ns / 1000, (unsigned long long)SchedDl_Throttled(), (unsigned long long)dl_overbudget);
+	HybridSleep_Print(&thread1_sleep, argv[1], stdout);
+	RtPrep_PrintFaults(&faults_start, &faults_boot, "Thread_1 warm-up", stdout);
+	RtPrep_PrintFaults(&faults_boot, &faults_end, "Thread_1 steady state", stdout);
+	RtPrep_Release();
+	LoadCal_Print(&thread1_load, "Heavy_Work", stdout);
+	Interference_Print(stdout);
+	if(json_file != NULL)
+		Report_Json(json_file, argv[1], argc == 4 ? atoi(argv[2]) : 10, period_ns);
+	if(csv_file != NULL)
+		Report_Csv(csv_file, argv[1], argc == 4 ? atoi(argv[2]) : 10, period_ns);
 		
 	return 0;
 }
@@ -218,57 +533,96 @@ int main(int argc, char *argv[])
 * Auxiliary functions 
 * ************************************************/
 
+/* Catches CTRL+C / SIGTERM to allow a controlled termination */
+void catch_signal(int sig)
+{
+	stop = 1;
+}
+
 /* Emulates task processing ... 
  * In the case integrates numerically a function
  * The "first" argument is a flag to signal the first (1) or subsequent
  * (0) activations 
- * "subInterval", which is the resolution, has a sigificant impact in the execution time
+ * "subInterval", which is the resolution, has a sigificant impact in the execution time;
+ * it is calibrated for the execution time given with -C (see loadCal.h)
+ * The integration itself is done by the fastest kernel for this CPU (see integKernel.h)
  */
- 
-#define f(x) 1/(1+pow(x,2)) /* Define function to integrate*/
 
 void Heavy_Work(unsigned char FirstFlag)
 {
-	float lower, upper, integration=0.0, stepSize, k;
-	int i, subInterval;
-	
-	struct timespec ts, // Function start time
-			tf; 		// Function finish time
-	
-	
-	/* Get start time */
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	
-	/* Integration parameters */
-	/* These values can be tunned to cause a desired load*/
-	lower=0;
-	upper=100;
-	subInterval=200000;
-
-	 /* Calculation */
-	 /* Finding step size */
-	 stepSize = (upper - lower)/subInterval;
-
-	 /* Finding Integration Value */
-	 integration = f(lower) + f(upper);
-	 for(i=1; i<= subInterval-1; i++)
-	 {
-		k = lower + i*stepSize;
-		integration = integration + 2 * f(k);
- 	}
-	integration = integration * stepSize/2;
+	double integration;
+
+	 /* Calculation (timed by the load calibration) */
+	integration = LoadCal_Run(&thread1_load);
  	
- 	/* Get finish time and show results */
+ 	/* Show results */
  	if (FirstFlag == TRUE) {
-		clock_gettime(CLOCK_MONOTONIC, &tf);
-		tf=TsSub(tf,ts);  // Compute time difference form start to finish
- 	
-		printf("Integration value is: %.3f. It took %4.2f ms to compute.\n", integration, (float)tf.tv_nsec/1000000);	
+		RtLog_Printf(&thread1_log, "Integration value is: %.3f. It took %4.2f ms to compute.\n", integration, (float)thread1_load.max_ns/1000000);	
 	}
 
 }
 
 
+/* Writes the results of the run as a JSON object: configuration,
+ * counters and the latency histograms (see HdrHist_PrintJson) */
+void Report_Json(const char *path, const char *name, int prio, uint64_t period_ns)
+{
+	FILE *f = fopen(path, "w");
+	struct utsname u;
+
+	if(f == NULL) {
+		printf("Could not write %s [%s]\n", path, strerror(errno));
+		return;
+	}
+	uname(&u);
+	fprintf(f, "{\n  \"name\": \"%s\",\n  \"kernel\": \"%s\",\n  \"period_us\": %llu,\n  \"priority\": %d,\n"
+		"  \"policy\": \"%s\",\n  \"cpu\": %d,\n  \"interference\": \"%s\",\n  \"duration_s\": %u,\n  \"timestamps\": \"%s\",\n",
+		name, u.release, (unsigned long long)period_ns / 1000, prio, dl_runtime_ns ? "deadline" : "fifo",
+		run_cpu, scenario, duration_s, TsClock_Source());
+	fprintf(f, "  \"jobs\": %llu,\n  \"deadline_us\": %llu,\n  \"deadline_misses\": %llu,\n  \"overruns\": %llu,\n",
+		(unsigned long long)thread1_stats.jobs, (unsigned long long)thread1_stats.deadline_ns / 1000,
+		(unsigned long long)thread1_stats.misses, (unsigned long long)thread1_ovr.overruns);
+	fprintf(f, "  \"jitter\": ");
+	HdrHist_PrintJson(&jitter_hist, f);
+	fprintf(f, ",\n  \"release_latency\": ");
+	HdrHist_PrintJson(&thread1_stats.release, f);
+	fprintf(f, ",\n  \"exec_time\": ");
+	HdrHist_PrintJson(&thread1_stats.exec, f);
+	fprintf(f, ",\n  \"response_time\": ");
+	HdrHist_PrintJson(&thread1_stats.resp, f);
+	fprintf(f, "\n}\n");
+	fclose(f);
+}
+
+/* Appends the summary of the run to a CSV file (header first, if empty). Times in us */
+void Report_Csv(const char *path, const char *name, int prio, uint64_t period_ns)
+{
+	FILE *f = fopen(path, "a");
+	struct utsname u;
+
+	if(f == NULL) {
+		printf("Could not write %s [%s]\n", path, strerror(errno));
+		return;
+	}
+	uname(&u);
+	if(ftell(f) == 0)
+		fprintf(f, "name,kernel,period_us,priority,policy,cpu,interference,duration_s,jobs,deadline_misses,overruns,"
+			"lat_min,lat_p50,lat_p99,lat_p99.9,lat_max,jitter_p50,jitter_p99,jitter_max,"
+			"resp_p50,resp_p99,resp_max\n");
+	fprintf(f, "%s,%s,%llu,%d,%s,%d,\"%s\",%u,%llu,%llu,%llu,", name, u.release, (unsigned long long)period_ns / 1000,
+		prio, dl_runtime_ns ? "deadline" : "fifo", run_cpu, scenario, duration_s, (unsigned long long)thread1_stats.jobs,
+		(unsigned long long)thread1_stats.misses, (unsigned long long)thread1_ovr.overruns);
+	fprintf(f, "%.3f,%.3f,%.3f,%.3f,%.3f,", (double)(thread1_stats.release.total ? thread1_stats.release.min : 0) / 1000,
+		(double)HdrHist_Percentile(&thread1_stats.release, 50.0) / 1000,
+		(double)HdrHist_Percentile(&thread1_stats.release, 99.0) / 1000,
+		(double)HdrHist_Percentile(&thread1_stats.release, 99.9) / 1000, (double)thread1_stats.release.max / 1000);
+	fprintf(f, "%.3f,%.3f,%.3f,", (double)HdrHist_Percentile(&jitter_hist, 50.0) / 1000,
+		(double)HdrHist_Percentile(&jitter_hist, 99.0) / 1000, (double)jitter_hist.max / 1000);
+	fprintf(f, "%.3f,%.3f,%.3f\n", (double)HdrHist_Percentile(&thread1_stats.resp, 50.0) / 1000,
+		(double)HdrHist_Percentile(&thread1_stats.resp, 99.0) / 1000, (double)thread1_stats.resp.max / 1000);
+	fclose(f);
+}
+
 // Adds two timespect variables
 struct  timespec  TsAdd(struct  timespec  ts1, struct  timespec  ts2){
 	
@@ -309,4 +663,16 @@ struct  timespec  TsSub (struct  timespec  ts1, struct  timespec  ts2) {
 
 }
 
+// Converts a timespec variable to ns
+int64_t TsToNs(struct  timespec  ts) {
+	return (int64_t)ts.tv_sec * NS_IN_SEC + ts.tv_nsec;
+}
+
+// Converts ns to a timespec variable
+struct  timespec  NsToTs(int64_t ns) {
+	struct  timespec  tr;
 
+	tr.tv_sec = ns / NS_IN_SEC;
+	tr.tv_nsec = ns % NS_IN_SEC;
+	return (tr);
+}
@@ -0,0 +1,142 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Binary activation trace - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "actTrace.h"
+
+_Static_assert(sizeof(struct actTraceHeader) == 128, "trace header must be 128 bytes");
+_Static_assert(sizeof(struct actTraceRecord) == 40, "trace record must be 40 bytes");
+
+/* Creates the trace file with room for "capacity" activations and
+ * maps it. The whole file is allocated and prefaulted here, so that
+ * recording never touches the file system. Returns 0 or -errno */
+int ActTrace_Open(struct actTrace *t, const char *path, const char *taskName,
+				  uint64_t period_ns, uint64_t capacity)
+{
+	int err;
+	void *map;
+
+	memset(t, 0, sizeof(*t));
+	t->fd = -1;
+	if(capacity == 0)
+		capacity = ACT_TRACE_DEFAULT_CAPACITY;
+	t->mapLen = sizeof(struct actTraceHeader) + capacity * sizeof(struct actTraceRecord);
+
+	t->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(t->fd < 0)
+		return -errno;
+
+	err = posix_fallocate(t->fd, 0, t->mapLen);
+	if(err == EOPNOTSUPP || err == EINVAL)	// File system without fallocate support
+		err = ftruncate(t->fd, t->mapLen) ? errno : 0;
+	if(err) {
+		close(t->fd);
+		return -err;
+	}
+
+	map = mmap(NULL, t->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, t->fd, 0);
+	if(map == MAP_FAILED) {
+		err = errno;
+		close(t->fd);
+		return -err;
+	}
+	mlock(map, t->mapLen); // Best effort: avoid page faults in the periodic loop
+
+	t->hdr = map;
+	memcpy(t->hdr->magic, ACT_TRACE_MAGIC, sizeof(t->hdr->magic));
+	t->hdr->version = ACT_TRACE_VERSION;
+	t->hdr->recordSize = sizeof(struct actTraceRecord);
+	t->hdr->capacity = capacity;
+	t->hdr->period_ns = period_ns;
+	strncpy(t->hdr->taskName, taskName, ACT_TRACE_NAME_LEN - 1);
+	atomic_store(&t->hdr->count, 0);
+	t->rec = (struct actTraceRecord *)(t->hdr + 1);
+	return 0;
+}
+
+/* Stores one activation (RT side, no syscalls) */
+void ActTrace_Record(struct actTrace *t, uint64_t release, uint64_t wakeup,
+					 uint64_t start, uint64_t end, uint32_t flags)
+{
+	uint64_t n;
+	struct actTraceRecord *r;
+
+	if(!ActTrace_Enabled(t))
+		return;
+
+	n = atomic_load_explicit(&t->hdr->count, memory_order_relaxed);
+	r = &t->rec[n % t->hdr->capacity];
+	r->release = release;
+	r->wakeup = wakeup;
+	r->start = start;
+	r->end = end;
+	r->seq = t->seq++;
+	r->flags = flags;
+	atomic_store_explicit(&t->hdr->count, n + 1, memory_order_release);
+}
+
+/* Flushes the trace to disk and releases the mapping */
+void ActTrace_Close(struct actTrace *t)
+{
+	if(t->hdr == NULL) // Never opened
+		return;
+
+	if(t->fd >= 0) {
+		msync(t->hdr, t->mapLen, MS_SYNC);
+		close(t->fd);
+	}
+	munmap(t->hdr, t->mapLen);
+	t->hdr = NULL;
+	t->rec = NULL;
+	t->fd = -1;
+}
+
+int ActTrace_Map(struct actTrace *t, const char *path)
+{
+	struct stat st;
+	void *map;
+	int err;
+
+	memset(t, 0, sizeof(*t));
+	t->fd = open(path, O_RDONLY);
+	if(t->fd < 0)
+		return -errno;
+	if(fstat(t->fd, &st) || (size_t)st.st_size < sizeof(struct actTraceHeader)) {
+		close(t->fd);
+		return -EINVAL;
+	}
+
+	t->mapLen = st.st_size;
+	map = mmap(NULL, t->mapLen, PROT_READ, MAP_SHARED, t->fd, 0);
+	if(map == MAP_FAILED) {
+		err = errno;
+		close(t->fd);
+		return -err;
+	}
+	t->hdr = map;
+
+	if(memcmp(t->hdr->magic, ACT_TRACE_MAGIC, sizeof(t->hdr->magic)) ||
+	   t->hdr->recordSize != sizeof(struct actTraceRecord) ||
+	   sizeof(struct actTraceHeader) + t->hdr->capacity * sizeof(struct actTraceRecord) > t->mapLen) {
+		munmap(map, t->mapLen);
+		close(t->fd);
+		t->hdr = NULL;
+		return -EINVAL;
+	}
+	close(t->fd);
+	t->fd = -1;
+	t->rec = (struct actTraceRecord *)(t->hdr + 1);
+	return 0;
+}
@@ -0,0 +1,78 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Binary activation trace
+ *
+ * Keeps the full timeline of each activation of a periodic task
+ * (expected release, actual wakeup, work start and work end) in a
+ * preallocated, memory-mapped file. Recording is a plain store in
+ * the mapping, so there is no write() (nor any other syscall) in
+ * the periodic loop. The file is a circular buffer: when it is full
+ * the oldest activations are overwritten, so after a long run it
+ * holds the last "capacity" activations (flight recorder).
+ *
+ * The traceReader tool converts trace files to CSV and computes
+ * jitter/response-time statistics.
+ *
+ *****************************************************************/
+
+#ifndef ACT_TRACE_H
+#define ACT_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define ACT_TRACE_MAGIC "RTTRACE1"
+#define ACT_TRACE_VERSION 1
+#define ACT_TRACE_DEFAULT_CAPACITY (1024*1024)	// Activations kept (40 bytes each)
+#define ACT_TRACE_NAME_LEN 32
+
+/* File header (fixed 128 bytes) */
+struct actTraceHeader {
+	char magic[8];					// ACT_TRACE_MAGIC
+	uint32_t version;
+	uint32_t recordSize;			// sizeof(struct actTraceRecord)
+	uint64_t capacity;				// Number of record slots in the file
+	_Atomic uint64_t count;			// Activations recorded so far (may exceed capacity)
+	uint64_t period_ns;				// Nominal task period
+	char taskName[ACT_TRACE_NAME_LEN];
+	uint8_t reserved[128 - 40 - ACT_TRACE_NAME_LEN];
+};
+
+/* One activation. All times are absolute, in ns of the task clock */
+struct actTraceRecord {
+	uint64_t release;				// Expected release (start of the period)
+	uint64_t wakeup;				// Actual wakeup
+	uint64_t start;					// Start of the job's work
+	uint64_t end;					// End of the job's work
+	uint32_t seq;					// Activation number
+	uint32_t flags;					// ACT_TRACE_F_xxx
+};
+
+#define ACT_TRACE_F_OVERRUN 0x1		// Activation released late (missed period(s))
+#define ACT_TRACE_F_DEADLINE_MISS 0x2	// Job finished after its (task configured) deadline
+
+struct actTrace {
+	int fd;
+	size_t mapLen;
+	struct actTraceHeader *hdr;
+	struct actTraceRecord *rec;		// NULL when tracing is disabled
+	uint32_t seq;
+};
+
+int ActTrace_Open(struct actTrace *t, const char *path, const char *taskName,
+				  uint64_t period_ns, uint64_t capacity);
+void ActTrace_Record(struct actTrace *t, uint64_t release, uint64_t wakeup,
+					 uint64_t start, uint64_t end, uint32_t flags);
+void ActTrace_Close(struct actTrace *t);
+
+/* Reader side: maps an existing trace read-only */
+int ActTrace_Map(struct actTrace *t, const char *path);
+
+static inline int ActTrace_Enabled(const struct actTrace *t)
+{
+	return t != NULL && t->rec != NULL;
+}
+
+#endif
@@ -0,0 +1,527 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Asynchronous double-buffered file writer - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "asyncWriter.h"
+
+/* io_uring needs the kernel headers of Linux >= 5.6 (IORING_OP_WRITE,
+ * IORING_REGISTER_PROBE): without them, only the thread pool is built */
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define AW_HAVE_IO_URING
+#endif
+#endif
+#endif
+
+#define AW_JOB_FSYNC -1
+#define AW_TAG_FSYNC ((uint64_t)-1)
+#define AW_TAG_WAKE ((uint64_t)-2)	// NOP that wakes the reaper to stop
+
+static uint64_t NowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Accounts the completion of a write of buffer idx (or of an fsync,
+ * AW_JOB_FSYNC) that gave "res". Returns 1 if the buffer still has data
+ * to write (short write). Called with the lock held */
+static int Complete(struct asyncWriter *w, int idx, ssize_t res)
+{
+	struct awBuf *b;
+
+	if(idx == AW_JOB_FSYNC) {
+		w->syncs--;
+		if(res < 0)
+			w->errors++;
+		else
+			w->fsyncs++;
+		pthread_cond_broadcast(&w->done);
+		return 0;
+	}
+	b = &w->buf[idx];
+	if(res > 0 && b->done + res < b->used) {
+		b->done += res;
+		return 1;
+	}
+	if(res <= 0) // Error, or nothing written: the data is dropped
+		w->errors++;
+	else {
+		w->writes++;
+		w->bytes += b->used;
+	}
+	HdrHist_Record(&w->latency, NowNs() - b->submit_ns);
+	w->inflight -= b->used;
+	b->used = 0;
+	b->busy = 0;
+	pthread_cond_broadcast(&w->done);
+	return 0;
+}
+
+/* ******************
+ * io_uring backend
+ * ******************/
+
+#ifdef AW_HAVE_IO_URING
+
+static int UringInit(struct asyncWriter *w)
+{
+	struct io_uring_params p;
+	struct io_uring_probe *probe;
+	int ok;
+
+	memset(&p, 0, sizeof(p));
+	w->ringFd = syscall(__NR_io_uring_setup, AW_RING_ENTRIES, &p);
+	if(w->ringFd < 0)
+		return -errno;
+
+	/* IORING_OP_WRITE is only there since Linux 5.6 */
+	probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+	ok = probe != NULL && syscall(__NR_io_uring_register, w->ringFd, IORING_REGISTER_PROBE, probe, 256) == 0
+		&& probe->last_op >= IORING_OP_WRITE && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	if(!ok) {
+		close(w->ringFd);
+		return -EOPNOTSUPP;
+	}
+
+	w->sqEntries = p.sq_entries;
+	w->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	w->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		if(w->cqRingSize > w->sqRingSize)
+			w->sqRingSize = w->cqRingSize;
+		w->cqRingSize = 0;
+	}
+	w->sqRing = mmap(NULL, w->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, w->ringFd, IORING_OFF_SQ_RING);
+	w->cqRing = w->cqRingSize == 0 ? w->sqRing
+		: mmap(NULL, w->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, w->ringFd, IORING_OFF_CQ_RING);
+	w->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, w->ringFd, IORING_OFF_SQES);
+	if(w->sqRing == MAP_FAILED || w->cqRing == MAP_FAILED || w->sqes == MAP_FAILED) {
+		close(w->ringFd); // The mappings that succeeded go with the process
+		return -ENOMEM;
+	}
+
+	w->sqHead = (unsigned *)((char *)w->sqRing + p.sq_off.head);
+	w->sqTail = (unsigned *)((char *)w->sqRing + p.sq_off.tail);
+	w->sqMask = (unsigned *)((char *)w->sqRing + p.sq_off.ring_mask);
+	w->sqArray = (unsigned *)((char *)w->sqRing + p.sq_off.array);
+	w->cqHead = (unsigned *)((char *)w->cqRing + p.cq_off.head);
+	w->cqTail = (unsigned *)((char *)w->cqRing + p.cq_off.tail);
+	w->cqMask = (unsigned *)((char *)w->cqRing + p.cq_off.ring_mask);
+	w->cqes = (char *)w->cqRing + p.cq_off.cqes;
+	return 0;
+}
+
+static void UringExit(struct asyncWriter *w)
+{
+	munmap(w->sqes, w->sqEntries * sizeof(struct io_uring_sqe));
+	if(w->cqRing != w->sqRing)
+		munmap(w->cqRing, w->cqRingSize);
+	munmap(w->sqRing, w->sqRingSize);
+	close(w->ringFd);
+}
+
+/* Queues the write of buffer idx (what is left of it) or an fsync
+ * after everything submitted before (idx AW_JOB_FSYNC). Returns 0 or
+ * -errno */
+static int UringSubmit(struct asyncWriter *w, int idx)
+{
+	unsigned tail = *w->sqTail, slot;
+	struct io_uring_sqe *sqe;
+	struct awBuf *b;
+
+	if(tail - __atomic_load_n(w->sqHead, __ATOMIC_ACQUIRE) >= w->sqEntries)
+		return -EBUSY;
+	slot = tail & *w->sqMask;
+	sqe = (struct io_uring_sqe *)w->sqes + slot;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->fd = w->fd;
+	if(idx == AW_JOB_FSYNC) {
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->flags = IOSQE_IO_DRAIN;
+		sqe->user_data = AW_TAG_FSYNC;
+	} else {
+		b = &w->buf[idx];
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->addr = (uintptr_t)(b->data + b->done);
+		sqe->len = b->used - b->done;
+		sqe->off = b->offset + b->done;
+		sqe->user_data = idx;
+	}
+	w->sqArray[slot] = slot;
+	__atomic_store_n(w->sqTail, tail + 1, __ATOMIC_RELEASE);
+	if(syscall(__NR_io_uring_enter, w->ringFd, 1, 0, 0, NULL, 0) < 0)
+		return -errno;
+	return 0;
+}
+
+/* Reaps the completions, without a syscall. Called with the lock held */
+static void UringReap(struct asyncWriter *w)
+{
+	unsigned head = *w->cqHead;
+	struct io_uring_cqe *cqe;
+	int idx;
+
+	while(head != __atomic_load_n(w->cqTail, __ATOMIC_ACQUIRE)) {
+		cqe = (struct io_uring_cqe *)w->cqes + (head & *w->cqMask);
+		idx = cqe->user_data == AW_TAG_FSYNC ? AW_JOB_FSYNC : (int)cqe->user_data;
+		head++;
+		if(cqe->user_data == AW_TAG_WAKE)
+			continue;
+		if(Complete(w, idx, cqe->res) && UringSubmit(w, idx) < 0)
+			Complete(w, idx, -EIO); // The rest of a short write could not be queued
+	}
+	__atomic_store_n(w->cqHead, head, __ATOMIC_RELEASE);
+}
+
+/* Waits for one completion at least */
+static void UringWait(struct asyncWriter *w)
+{
+	syscall(__NR_io_uring_enter, w->ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+/* Reaps the completions as they arrive, so that their latency is the
+ * one of the write and not the time to the caller's next call */
+static void *Reaper(void *arg)
+{
+	struct asyncWriter *w = arg;
+
+	pthread_mutex_lock(&w->lock);
+	while(!w->stop) {
+		pthread_mutex_unlock(&w->lock);
+		UringWait(w);
+		pthread_mutex_lock(&w->lock);
+		UringReap(w);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+/* Wakes the reaper up (after w->stop is set) with a NOP */
+static void UringWake(struct asyncWriter *w)
+{
+	unsigned tail = *w->sqTail, slot = tail & *w->sqMask;
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *)w->sqes + slot;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_NOP;
+	sqe->user_data = AW_TAG_WAKE;
+	w->sqArray[slot] = slot;
+	__atomic_store_n(w->sqTail, tail + 1, __ATOMIC_RELEASE);
+	syscall(__NR_io_uring_enter, w->ringFd, 1, 0, 0, NULL, 0);
+}
+
+#else
+
+static int UringInit(struct asyncWriter *w)
+{
+	(void)w;
+	return -ENOSYS;
+}
+
+static void UringExit(struct asyncWriter *w) { (void)w; }
+static int UringSubmit(struct asyncWriter *w, int idx) { (void)w; (void)idx; return -ENOSYS; }
+static void UringReap(struct asyncWriter *w) { (void)w; }
+static void UringWait(struct asyncWriter *w) { (void)w; }
+static void *Reaper(void *arg) { return arg; }
+static void UringWake(struct asyncWriter *w) { (void)w; }
+
+#endif
+
+/* ******************
+ * Thread pool backend
+ * ******************/
+
+static void *Worker(void *arg)
+{
+	struct asyncWriter *w = arg;
+	struct awBuf *b;
+	ssize_t res, n;
+	int job;
+
+	pthread_mutex_lock(&w->lock);
+	for(;;) {
+		while(!w->stop && w->njobs == 0)
+			pthread_cond_wait(&w->work, &w->lock);
+		if(w->njobs == 0)
+			break; // Stopped, and nothing left
+		job = w->jobs[w->jobHead];
+		w->jobHead = (w->jobHead + 1) % AW_MAX_JOBS;
+		w->njobs--;
+
+		if(job == AW_JOB_FSYNC) {
+			/* After the writes queued before it, which other
+			 * workers took already */
+			while(w->buf[0].busy || w->buf[1].busy)
+				pthread_cond_wait(&w->done, &w->lock);
+			pthread_mutex_unlock(&w->lock);
+			res = fsync(w->fd) ? -errno : 0;
+		} else {
+			b = &w->buf[job];
+			pthread_mutex_unlock(&w->lock);
+			for(res = 0; b->done < b->used; b->done += n, res += n)
+				if((n = pwrite(w->fd, b->data + b->done, b->used - b->done, b->offset + b->done)) <= 0) {
+					if(n < 0 && errno == EINTR) {
+						n = 0;
+						continue;
+					}
+					res = n < 0 ? -errno : 0;
+					break;
+				}
+		}
+		pthread_mutex_lock(&w->lock);
+		Complete(w, job, res);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+/* Queues a job for the workers. Called with the lock held */
+static int PoolSubmit(struct asyncWriter *w, int job)
+{
+	if(w->njobs == AW_MAX_JOBS)
+		return -EBUSY;
+	w->jobs[(w->jobHead + w->njobs) % AW_MAX_JOBS] = job;
+	w->njobs++;
+	pthread_cond_signal(&w->work);
+	return 0;
+}
+
+/* ******************
+ * Writer
+ * ******************/
+
+/* Opens a writer appending to fd (from its current offset) with
+ * buffers of bufSize bytes (0: AW_DEFAULT_BUF_SIZE). AW_AUTO uses
+ * io_uring if available, else the thread pool. Returns 0 or -errno */
+int AsyncWriter_Open(struct asyncWriter *w, int fd, size_t bufSize, enum awBackend backend)
+{
+	off_t offset;
+	int i, err;
+
+	memset(w, 0, sizeof(*w));
+	w->fd = fd;
+	w->bufSize = bufSize ? bufSize : AW_DEFAULT_BUF_SIZE;
+	offset = lseek(fd, 0, SEEK_CUR);
+	w->offset = offset > 0 ? offset : 0;
+	for(i = 0; i < AW_NBUF; i++) {
+		if(posix_memalign((void **)&w->buf[i].data, 4096, w->bufSize)) {
+			while(i--)
+				free(w->buf[i].data);
+			return -ENOMEM;
+		}
+		memset(w->buf[i].data, 0, w->bufSize); // Prefault
+	}
+	HdrHist_Init(&w->latency, HDR_DEFAULT_PRECISION_BITS);
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->work, NULL);
+	pthread_cond_init(&w->done, NULL);
+
+	if(backend != AW_THREADS_POOL) {
+		err = UringInit(w);
+		if(err == 0) {
+			w->backend = AW_IO_URING;
+			if((err = pthread_create(&w->threads[0], NULL, Reaper, w)) != 0) {
+				AsyncWriter_Close(w);
+				return -err;
+			}
+			w->nthreads = 1;
+			return 0;
+		}
+		if(backend == AW_IO_URING) {
+			AsyncWriter_Close(w);
+			return err;
+		}
+	}
+	w->backend = AW_THREADS_POOL;
+	for(w->nthreads = 0; w->nthreads < AW_THREADS; w->nthreads++)
+		if((err = pthread_create(&w->threads[w->nthreads], NULL, Worker, w)) != 0) {
+			AsyncWriter_Close(w);
+			return -err;
+		}
+	return 0;
+}
+
+/* Submits buffer idx (or an fsync). Called with the lock held */
+static void Submit(struct asyncWriter *w, int idx)
+{
+	struct awBuf *b;
+	int err;
+
+	if(idx == AW_JOB_FSYNC)
+		w->syncs++;
+	else {
+		b = &w->buf[idx];
+		b->busy = 1;
+		b->done = 0;
+		b->offset = w->offset;
+		b->submit_ns = NowNs();
+		w->offset += b->used;
+		w->inflight += b->used;
+		if(w->inflight > w->maxInflight)
+			w->maxInflight = w->inflight;
+	}
+	err = w->backend == AW_IO_URING ? UringSubmit(w, idx) : PoolSubmit(w, idx);
+	if(err)
+		Complete(w, idx, err);
+}
+
+/* Waits until buffer idx is idle (all of them, idx < 0) and, with
+ * idx < 0, the fsyncs done. Called with the lock held */
+static void WaitIdle(struct asyncWriter *w, int idx)
+{
+	for(;;) {
+		if(w->backend == AW_IO_URING)
+			UringReap(w);
+		if(idx >= 0 ? !w->buf[idx].busy : !w->buf[0].busy && !w->buf[1].busy && w->syncs == 0)
+			return;
+		/* io_uring: the reaper signals too (waiting in the ring here
+		 * could miss a completion it reaped) */
+		pthread_cond_wait(&w->done, &w->lock);
+	}
+}
+
+/* Submits the current buffer and switches to the other one, waiting
+ * for it if still in flight. Called with the lock held */
+static void Switch(struct asyncWriter *w)
+{
+	Submit(w, w->cur);
+	w->cur = (w->cur + 1) % AW_NBUF;
+	if(w->backend == AW_IO_URING)
+		UringReap(w);
+	if(w->buf[w->cur].busy) {
+		w->stalls++;
+		WaitIdle(w, w->cur);
+	}
+}
+
+/* The writer calls are not cancellation points: a task cancelled in
+ * one of them (rt_task_delete) would leave the lock held */
+#define NO_CANCEL_BEGIN(old) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old)
+#define NO_CANCEL_END(old) pthread_setcancelstate(old, NULL)
+
+int AsyncWriter_Append(struct asyncWriter *w, const void *data, size_t len)
+{
+	const char *p = data;
+	struct awBuf *b;
+	size_t n;
+	int old;
+
+	NO_CANCEL_BEGIN(old);
+	pthread_mutex_lock(&w->lock);
+	while(len > 0) {
+		b = &w->buf[w->cur];
+		n = w->bufSize - b->used < len ? w->bufSize - b->used : len;
+		memcpy(b->data + b->used, p, n);
+		b->used += n;
+		p += n;
+		len -= n;
+		if(b->used == w->bufSize)
+			Switch(w);
+	}
+	pthread_mutex_unlock(&w->lock);
+	NO_CANCEL_END(old);
+	return 0;
+}
+
+/* Submits the current buffer if the other one is idle (never blocks) */
+void AsyncWriter_Flush(struct asyncWriter *w)
+{
+	int old;
+
+	NO_CANCEL_BEGIN(old);
+	pthread_mutex_lock(&w->lock);
+	if(w->backend == AW_IO_URING)
+		UringReap(w);
+	if(w->buf[w->cur].used > 0 && !w->buf[(w->cur + 1) % AW_NBUF].busy)
+		Switch(w);
+	pthread_mutex_unlock(&w->lock);
+	NO_CANCEL_END(old);
+}
+
+/* Queues an fsync after the writes submitted so far, unless one is
+ * still pending */
+void AsyncWriter_Sync(struct asyncWriter *w)
+{
+	int old;
+
+	NO_CANCEL_BEGIN(old);
+	pthread_mutex_lock(&w->lock);
+	if(w->syncs == 0)
+		Submit(w, AW_JOB_FSYNC);
+	pthread_mutex_unlock(&w->lock);
+	NO_CANCEL_END(old);
+}
+
+/* Accounts the completed writes (io_uring: without a syscall) */
+void AsyncWriter_Poll(struct asyncWriter *w)
+{
+	int old;
+
+	if(w->backend != AW_IO_URING)
+		return; // The workers do it
+	NO_CANCEL_BEGIN(old);
+	pthread_mutex_lock(&w->lock);
+	UringReap(w);
+	pthread_mutex_unlock(&w->lock);
+	NO_CANCEL_END(old);
+}
+
+/* Writes what is left, waits for every write and releases the writer */
+void AsyncWriter_Close(struct asyncWriter *w)
+{
+	int i;
+
+	pthread_mutex_lock(&w->lock);
+	if(w->backend != AW_AUTO) { // Opened
+		if(w->buf[w->cur].used > 0)
+			Switch(w);
+		WaitIdle(w, -1);
+	}
+	w->stop = 1;
+	pthread_cond_broadcast(&w->work);
+	if(w->backend == AW_IO_URING && w->nthreads)
+		UringWake(w);
+	pthread_mutex_unlock(&w->lock);
+	for(i = 0; i < w->nthreads; i++)
+		pthread_join(w->threads[i], NULL);
+	w->nthreads = 0;
+	if(w->backend == AW_IO_URING)
+		UringExit(w);
+	for(i = 0; i < AW_NBUF; i++) {
+		free(w->buf[i].data);
+		w->buf[i].data = NULL;
+	}
+}
+
+const char *AsyncWriter_BackendName(const struct asyncWriter *w)
+{
+	return w->backend == AW_IO_URING ? "io_uring" : "thread pool";
+}
+
+void AsyncWriter_Print(const struct asyncWriter *w, FILE *out)
+{
+	fprintf(out, "Async writer (%s, 2 x %zu bytes): %llu writes, %llu bytes, %llu fsyncs, %llu stalls, %llu errors, max %llu bytes in flight\n",
+		AsyncWriter_BackendName(w), w->bufSize, (unsigned long long)w->writes, (unsigned long long)w->bytes,
+		(unsigned long long)w->fsyncs, (unsigned long long)w->stalls, (unsigned long long)w->errors,
+		(unsigned long long)w->maxInflight);
+	HdrHist_Print(&w->latency, "  Write completion latency", out);
+}
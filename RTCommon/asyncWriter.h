@@ -0,0 +1,101 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Asynchronous double-buffered file writer
+ *
+ * Output is appended to one of two buffers while the other is being
+ * written. A buffer is submitted when it fills or on
+ * AsyncWriter_Flush() (if the other one is idle: otherwise its data
+ * waits for the next flush), so the caller only blocks when it fills
+ * a buffer while the other is still being written (counted in
+ * "stalls"). The writes go through:
+ *	- io_uring (raw syscalls, no liburing): one io_uring_enter per
+ *	  submission; the completions are reaped by a thread waiting for
+ *	  them (so the latency histogram measures the write) or, first,
+ *	  by the caller, from the shared ring without a syscall
+ *	  (AsyncWriter_Poll)
+ *	- a pool of AW_THREADS threads doing pwrite(), when io_uring is
+ *	  not available (old kernel or headers, disabled by sysctl or
+ *	  seccomp) or not wanted
+ * Each buffer is written at its own file offset, so the writes can
+ * complete in any order. AsyncWriter_Sync() queues an fsync after the
+ * writes submitted so far.
+ *
+ * Counters: bytes in flight (current and max), writes, fsyncs,
+ * stalls, errors and the completion latency (submission to reaped
+ * completion) histogram.
+ *
+ *****************************************************************/
+
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "hdrHist.h"
+
+#define AW_NBUF 2			// Double buffering
+#define AW_THREADS 2			// Workers of the thread pool backend (io_uring: 1 reaper)
+#define AW_DEFAULT_BUF_SIZE (64*1024)
+#define AW_RING_ENTRIES 8		// io_uring submission queue
+#define AW_MAX_JOBS 8			// Thread pool queue (writes and fsyncs)
+
+enum awBackend { AW_AUTO, AW_IO_URING, AW_THREADS_POOL };
+
+struct awBuf {
+	char *data;
+	size_t used;			// Appended
+	size_t done;			// Written, while in flight
+	off_t offset;			// File offset
+	int busy;			// In flight
+	uint64_t submit_ns;
+};
+
+struct asyncWriter {
+	int fd;
+	enum awBackend backend;
+	size_t bufSize;
+	struct awBuf buf[AW_NBUF];
+	int cur;			// Buffer being filled
+	off_t offset;			// File offset of the next write
+	int syncs;			// fsyncs in flight
+
+	/* Counters */
+	uint64_t writes, bytes, fsyncs, stalls, errors;
+	uint64_t inflight, maxInflight;	// Bytes submitted and not yet written
+	struct hdrHist latency;		// Write completion latency
+
+	/* io_uring */
+	int ringFd;
+	void *sqRing, *cqRing;
+	size_t sqRingSize, cqRingSize;
+	void *sqes;
+	unsigned sqEntries;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	void *cqes;
+
+	/* Thread pool */
+	pthread_t threads[AW_THREADS];
+	int nthreads;
+	pthread_mutex_t lock;
+	pthread_cond_t work, done;
+	int jobs[AW_MAX_JOBS];		// Buffer index, or AW_JOB_FSYNC
+	int jobHead, njobs;
+	int stop;
+};
+
+int AsyncWriter_Open(struct asyncWriter *w, int fd, size_t bufSize, enum awBackend backend);
+int AsyncWriter_Append(struct asyncWriter *w, const void *data, size_t len);
+void AsyncWriter_Flush(struct asyncWriter *w);
+void AsyncWriter_Sync(struct asyncWriter *w);
+void AsyncWriter_Poll(struct asyncWriter *w);
+void AsyncWriter_Close(struct asyncWriter *w);
+const char *AsyncWriter_BackendName(const struct asyncWriter *w);
+void AsyncWriter_Print(const struct asyncWriter *w, FILE *out);
+
+#endif
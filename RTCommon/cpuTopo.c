@@ -0,0 +1,266 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Topology-aware CPU placement of RT tasks - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "cpuTopo.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+/* Reads the first line of a sysfs file. Returns 0, or -1 if unreadable */
+static int ReadLine(const char *path, char *buf, size_t size)
+{
+	FILE *f = fopen(path, "r");
+	int ok;
+
+	if(f == NULL)
+		return -1;
+	ok = fgets(buf, size, f) != NULL;
+	fclose(f);
+	if(!ok)
+		return -1;
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/* Parses a CPU list ("0-3,8", as in sysfs and the kernel command line).
+ * Returns the number of CPUs, or -1 if malformed */
+int CpuTopo_ParseList(const char *list, cpu_set_t *set)
+{
+	char *end;
+	long a, b;
+	int n = 0;
+
+	CPU_ZERO(set);
+	while(*list) {
+		a = strtol(list, &end, 10);
+		if(end == list || a < 0 || a >= CPU_SETSIZE)
+			return -1;
+		b = a;
+		if(*end == '-') {
+			list = end + 1;
+			b = strtol(list, &end, 10);
+			if(end == list || b < a || b >= CPU_SETSIZE)
+				return -1;
+		}
+		for(; a <= b; a++, n++)
+			CPU_SET(a, set);
+		if(*end == ',')
+			end++;
+		else if(*end != '\0')
+			return -1;
+		list = end;
+	}
+	return n;
+}
+
+/* First CPU of a sysfs list file, or "cpu" if unreadable */
+static int FirstOf(const char *path, int cpu, cpu_set_t *set)
+{
+	char buf[256];
+	int i;
+
+	if(ReadLine(path, buf, sizeof(buf)) || CpuTopo_ParseList(buf, set) <= 0) {
+		CPU_ZERO(set);
+		CPU_SET(cpu, set);
+		return cpu;
+	}
+	for(i = 0; !CPU_ISSET(i, set); i++);
+	return i;
+}
+
+/* Reads the topology. Returns 0, or -errno if the online CPUs are unknown */
+int CpuTopo_Read(struct cpuTopo *t)
+{
+	char path[128], buf[256];
+	cpu_set_t llcSet;
+	int cpu, idx, level, maxLevel;
+
+	memset(t, 0, sizeof(*t));
+	if(ReadLine(SYSFS_CPU "/online", buf, sizeof(buf)) || CpuTopo_ParseList(buf, &t->online) <= 0) {
+		/* No sysfs: every CPU we may run on is online, without topology */
+		if(sched_getaffinity(0, sizeof(t->online), &t->online))
+			return -errno;
+	}
+	if(ReadLine(SYSFS_CPU "/isolated", buf, sizeof(buf)) || CpuTopo_ParseList(buf, &t->isolated) < 0)
+		CPU_ZERO(&t->isolated);
+	if(ReadLine(SYSFS_CPU "/nohz_full", buf, sizeof(buf)) || CpuTopo_ParseList(buf, &t->nohzFull) < 0)
+		CPU_ZERO(&t->nohzFull);
+
+	for(cpu = 0; cpu < TOPO_MAX_CPUS; cpu++) {
+		if(!CPU_ISSET(cpu, &t->online))
+			continue;
+		t->ncpus = cpu + 1;
+		t->cpu[cpu].online = 1;
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/thread_siblings_list", cpu);
+		t->cpu[cpu].core = FirstOf(path, cpu, &t->cpu[cpu].siblings);
+
+		/* The last level cache is the highest level index */
+		t->cpu[cpu].llc = cpu;
+		for(idx = 0, maxLevel = 0; ; idx++) {
+			snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/level", cpu, idx);
+			if(ReadLine(path, buf, sizeof(buf)))
+				break;
+			level = atoi(buf);
+			if(level > maxLevel) {
+				maxLevel = level;
+				snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+				t->cpu[cpu].llc = FirstOf(path, cpu, &llcSet);
+			}
+		}
+	}
+	return 0;
+}
+
+/* Marks the CPUs as used by a RT task, and their SMT siblings as reserved */
+void CpuTopo_Assign(struct cpuTopo *t, const cpu_set_t *set)
+{
+	int cpu;
+
+	for(cpu = 0; cpu < t->ncpus; cpu++) {
+		if(!CPU_ISSET(cpu, set))
+			continue;
+		CPU_SET(cpu, &t->used);
+		CPU_OR(&t->reserved, &t->reserved, &t->cpu[cpu].siblings);
+		CPU_SET(cpu, &t->reserved);
+	}
+}
+
+/* Picks the best CPU for a RT task (see cpuTopo.h) and assigns it.
+ * When every CPU is reserved, the least preferred sharing is used:
+ * an SMT sibling, then a CPU of another task. Returns the CPU */
+int CpuTopo_Pick(struct cpuTopo *t, cpu_set_t *set)
+{
+	int cpu, sib, score, best = -1, bestScore = -1, wholeCore;
+
+	for(cpu = 0; cpu < t->ncpus; cpu++) {
+		if(!t->cpu[cpu].online)
+			continue;
+		for(sib = 0, wholeCore = 1; sib < t->ncpus; sib++)
+			if(CPU_ISSET(sib, &t->cpu[cpu].siblings) && CPU_ISSET(sib, &t->reserved))
+				wholeCore = 0;
+		score = (!CPU_ISSET(cpu, &t->used) << 6) | (!CPU_ISSET(cpu, &t->reserved) << 5)
+			| (CPU_ISSET(cpu, &t->isolated) << 4) | (wholeCore << 3)
+			| (CPU_ISSET(cpu, &t->nohzFull) << 2) | ((cpu != 0) << 1);
+		if(score > bestScore) {
+			best = cpu;
+			bestScore = score;
+		}
+	}
+	if(best < 0) // No topology at all
+		best = 0;
+	CPU_ZERO(set);
+	CPU_SET(best, set);
+	CpuTopo_Assign(t, set);
+	return best;
+}
+
+/* CPUs for the non-RT threads: online, not isolated and not reserved;
+ * failing that, any not used by a RT task; failing that, all online */
+void CpuTopo_Housekeeping(const struct cpuTopo *t, cpu_set_t *set)
+{
+	int cpu;
+
+	CPU_ZERO(set);
+	for(cpu = 0; cpu < t->ncpus; cpu++)
+		if(t->cpu[cpu].online && !CPU_ISSET(cpu, &t->reserved) && !CPU_ISSET(cpu, &t->isolated))
+			CPU_SET(cpu, set);
+	for(cpu = 0; cpu < t->ncpus && CPU_COUNT(set) == 0; cpu++) // SMT siblings of the RT CPUs
+		if(t->cpu[cpu].online && !CPU_ISSET(cpu, &t->used) && !CPU_ISSET(cpu, &t->isolated))
+			CPU_SET(cpu, set);
+	for(cpu = 0; cpu < t->ncpus && CPU_COUNT(set) == 0; cpu++)
+		if(t->cpu[cpu].online && !CPU_ISSET(cpu, &t->used))
+			CPU_SET(cpu, set);
+	if(CPU_COUNT(set) == 0)
+		*set = t->online;
+}
+
+const char *CpuTopo_ListStr(const cpu_set_t *set, char *buf, size_t size)
+{
+	size_t n = 0;
+	int a, b;
+
+	buf[0] = '\0';
+	for(a = 0; a < CPU_SETSIZE && n < size; a++) {
+		if(!CPU_ISSET(a, set))
+			continue;
+		for(b = a; b + 1 < CPU_SETSIZE && CPU_ISSET(b + 1, set); b++);
+		if(b == a)
+			n += snprintf(buf + n, size - n, "%s%d", n ? "," : "", a);
+		else
+			n += snprintf(buf + n, size - n, "%s%d-%d", n ? "," : "", a, b);
+		a = b;
+	}
+	if(n == 0)
+		snprintf(buf, size, "none");
+	return buf;
+}
+
+/* Prints where the task "name" runs, warning when one of its CPUs is
+ * not isolated, is offline or shares its core with other RT tasks or
+ * with non-isolated CPUs. Returns the number of warnings */
+int CpuTopo_Check(const struct cpuTopo *t, const cpu_set_t *set, const char *name, FILE *out)
+{
+	char buf[256];
+	int cpu, sib, warnings = 0;
+
+	fprintf(out, "Placement: %s on CPU %s", name, CpuTopo_ListStr(set, buf, sizeof(buf)));
+	for(cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if(CPU_ISSET(cpu, set) && cpu < t->ncpus)
+			fprintf(out, " [cpu %d: core %d, LLC %d%s%s]", cpu, t->cpu[cpu].core, t->cpu[cpu].llc,
+				CPU_ISSET(cpu, &t->isolated) ? ", isolated" : "", CPU_ISSET(cpu, &t->nohzFull) ? ", nohz_full" : "");
+	fprintf(out, "\n");
+
+	for(cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if(!CPU_ISSET(cpu, set))
+			continue;
+		if(cpu >= t->ncpus || !t->cpu[cpu].online) {
+			fprintf(out, "Warning: %s: CPU %d is not online\n", name, cpu);
+			warnings++;
+			continue;
+		}
+		if(!CPU_ISSET(cpu, &t->isolated)) {
+			fprintf(out, "Warning: %s: CPU %d is not isolated (isolcpus=), other processes may run on it\n", name, cpu);
+			warnings++;
+		}
+		for(sib = 0; sib < t->ncpus; sib++) {
+			if(sib == cpu || !CPU_ISSET(sib, &t->cpu[cpu].siblings) || CPU_ISSET(sib, set))
+				continue;
+			if(CPU_ISSET(sib, &t->used)) {
+				fprintf(out, "Warning: %s: CPU %d shares its core with CPU %d, used by another RT task\n", name, cpu, sib);
+				warnings++;
+			} else if(!CPU_ISSET(sib, &t->isolated)) {
+				fprintf(out, "Warning: %s: CPU %d shares its core with CPU %d (SMT), which is not isolated\n", name, cpu, sib);
+				warnings++;
+			}
+		}
+	}
+	return warnings;
+}
+
+void CpuTopo_Print(const struct cpuTopo *t, FILE *out)
+{
+	char online[256], isolated[256], nohz[256];
+	cpu_set_t cores, llcs;
+	int cpu;
+
+	CPU_ZERO(&cores);
+	CPU_ZERO(&llcs);
+	for(cpu = 0; cpu < t->ncpus; cpu++)
+		if(t->cpu[cpu].online) {
+			CPU_SET(t->cpu[cpu].core, &cores);
+			CPU_SET(t->cpu[cpu].llc, &llcs);
+		}
+	fprintf(out, "Topology: CPUs %s, %d cores, %d LLC domains, isolated: %s, nohz_full: %s\n",
+		CpuTopo_ListStr(&t->online, online, sizeof(online)), CPU_COUNT(&cores), CPU_COUNT(&llcs),
+		CpuTopo_ListStr(&t->isolated, isolated, sizeof(isolated)),
+		CpuTopo_ListStr(&t->nohzFull, nohz, sizeof(nohz)));
+}
@@ -0,0 +1,54 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Topology-aware CPU placement of RT tasks
+ *
+ * CpuTopo_Read() takes the machine topology from sysfs: online CPUs,
+ * cores (SMT siblings), last level cache sharing and the CPUs
+ * isolated from the scheduler (isolcpus=) or from the tick
+ * (nohz_full=). RT tasks are then given CPUs with:
+ *	- CpuTopo_Pick(): the best free CPU, preferring isolated CPUs,
+ *	  cores with every SMT sibling free, nohz_full CPUs and any CPU
+ *	  but 0 (the usual target of IRQs and housekeeping work)
+ *	- CpuTopo_Assign(): a CPU set given by the configuration
+ * Either way the CPUs and their SMT siblings are reserved, so later
+ * picks keep the siblings idle. CpuTopo_Housekeeping() gives the
+ * CPUs left for the non-RT threads (main, logger, ...) and
+ * CpuTopo_Check() prints the placement of a task, warning when it is
+ * not isolated or shares a core with other work.
+ *
+ *****************************************************************/
+
+#ifndef CPU_TOPO_H
+#define CPU_TOPO_H
+
+#include <stdio.h>
+#include <sched.h>		// cpu_set_t: include with _GNU_SOURCE defined
+
+#define TOPO_MAX_CPUS 256
+
+struct topoCpu {
+	int online;
+	int core;			// First CPU of the core (SMT siblings)
+	int llc;			// First CPU sharing the last level cache
+	cpu_set_t siblings;		// CPUs of the same core, itself included
+};
+
+struct cpuTopo {
+	int ncpus;			// Highest CPU number + 1
+	struct topoCpu cpu[TOPO_MAX_CPUS];
+	cpu_set_t online, isolated, nohzFull;
+	cpu_set_t used;			// CPUs given to RT tasks
+	cpu_set_t reserved;		// used, plus their SMT siblings
+};
+
+int CpuTopo_Read(struct cpuTopo *t);
+int CpuTopo_ParseList(const char *list, cpu_set_t *set);
+int CpuTopo_Pick(struct cpuTopo *t, cpu_set_t *set);
+void CpuTopo_Assign(struct cpuTopo *t, const cpu_set_t *set);
+void CpuTopo_Housekeeping(const struct cpuTopo *t, cpu_set_t *set);
+int CpuTopo_Check(const struct cpuTopo *t, const cpu_set_t *set, const char *name, FILE *out);
+void CpuTopo_Print(const struct cpuTopo *t, FILE *out);
+const char *CpuTopo_ListStr(const cpu_set_t *set, char *buf, size_t size);
+
+#endif
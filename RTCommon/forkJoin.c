@@ -0,0 +1,209 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Parallel (fork-join) Heavy_Work - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "forkJoin.h"
+#include "integKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CpuRelax() __builtin_ia32_pause()
+#else
+#define CpuRelax() do { } while(0)
+#endif
+
+/* One slice of the job, on its own cache line */
+struct fjSlice {
+	_Alignas(64) float lower, upper;
+	int subInterval;
+	double result;
+};
+
+static struct {
+	int nworkers;
+	pthread_t threads[FJ_MAX_WORKERS];
+	integKernelFn kernel;			// Kernel used by every slice
+	struct fjSlice slice[FJ_MAX_WORKERS + 1];	// Slice 0 is the caller's
+	_Alignas(64) _Atomic uint32_t gen;	// Job generation (futex, workers wait on it)
+	_Alignas(64) _Atomic uint32_t pending;	// Slices not yet done (futex, caller waits on it)
+	volatile int stop;
+} pool;
+
+static long Futex(_Atomic uint32_t *addr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, (uint32_t *)addr, op, val, NULL, NULL, 0);
+}
+
+/* Spins while *addr == val, then sleeps on the futex. Returns the new value */
+static uint32_t WaitChange(_Atomic uint32_t *addr, uint32_t val)
+{
+	uint32_t v;
+	int i;
+
+	for(i = 0; i < FJ_SPIN_ITERS; i++) {
+		v = atomic_load_explicit(addr, memory_order_acquire);
+		if(v != val)
+			return v;
+		CpuRelax();
+	}
+	while((v = atomic_load_explicit(addr, memory_order_acquire)) == val)
+		Futex(addr, FUTEX_WAIT_PRIVATE, val);
+	return v;
+}
+
+static void *Worker_code(void *arg)
+{
+	struct fjSlice *s = &pool.slice[(intptr_t)arg];
+	uint32_t seen = 0; // Generation when the pool was created
+
+	for(;;) {
+		seen = WaitChange(&pool.gen, seen);
+		if(pool.stop)
+			break;
+		s->result = pool.kernel(s->lower, s->upper, s->subInterval);
+		if(atomic_fetch_sub_explicit(&pool.pending, 1, memory_order_acq_rel) == 1)
+			Futex(&pool.pending, FUTEX_WAKE_PRIVATE, 1);
+	}
+	return NULL;
+}
+
+/* Creates nworkers threads, worker i pinned to cpus[i], with the given
+ * policy/priority (normally those of the task that uses the pool).
+ * Must be called after IntegKernel_Select(). Returns 0 or -errno */
+int ForkJoin_Start(const int *cpus, int nworkers, int policy, int priority)
+{
+	pthread_attr_t attr;
+	struct sched_param parm;
+	cpu_set_t cpuset;
+	intptr_t i;
+	int err = 0;
+
+	if(nworkers < 1 || nworkers > FJ_MAX_WORKERS)
+		return -EINVAL;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.kernel = Integ_Kernel;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, policy);
+	parm.sched_priority = priority;
+	pthread_attr_setschedparam(&attr, &parm);
+	for(i = 0; i < nworkers; i++) {
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpus[i], &cpuset);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+		err = pthread_create(&pool.threads[i], &attr, Worker_code, (void *)(i + 1));
+		if(err)
+			break;
+		pool.nworkers++;
+	}
+	pthread_attr_destroy(&attr);
+
+	if(err) {
+		ForkJoin_Stop();
+		return -err;
+	}
+	return 0;
+}
+
+/* Integrates with the pool (same result as Integ_Kernel, to rounding).
+ * Without a pool, or for small jobs, runs the serial kernel */
+double ForkJoin_Kernel(float lower, float upper, int subInterval)
+{
+	double stepSize, sum;
+	int nslices = pool.nworkers + 1, first = 0, n, i;
+
+	if(pool.nworkers == 0 || subInterval < FJ_MIN_SLICE * nslices)
+		return Integ_Kernel(lower, upper, subInterval);
+
+	/* Contiguous slices; the trapezoids of the slices add up to the
+	 * trapezoid of the whole range */
+	stepSize = ((double)upper - lower) / subInterval;
+	for(i = 0; i < nslices; i++) {
+		n = subInterval / nslices + (i < subInterval % nslices);
+		pool.slice[i].lower = lower + first * stepSize;
+		pool.slice[i].upper = i == nslices - 1 ? upper : lower + (first + n) * stepSize;
+		pool.slice[i].subInterval = n;
+		first += n;
+	}
+
+	/* Fork */
+	atomic_store_explicit(&pool.pending, pool.nworkers, memory_order_relaxed);
+	atomic_fetch_add_explicit(&pool.gen, 1, memory_order_release);
+	Futex(&pool.gen, FUTEX_WAKE_PRIVATE, INT32_MAX);
+
+	pool.slice[0].result = pool.kernel(pool.slice[0].lower, pool.slice[0].upper, pool.slice[0].subInterval);
+
+	/* Join and reduce, always in the same order */
+	for(n = atomic_load_explicit(&pool.pending, memory_order_acquire); n != 0; )
+		n = WaitChange(&pool.pending, n);
+	for(i = 0, sum = 0.0; i < nslices; i++)
+		sum += pool.slice[i].result;
+	return sum;
+}
+
+int ForkJoin_Workers(void)
+{
+	return pool.nworkers;
+}
+
+/* Terminates the workers */
+void ForkJoin_Stop(void)
+{
+	int i;
+
+	if(pool.nworkers == 0)
+		return;
+
+	pool.stop = 1;
+	atomic_fetch_add_explicit(&pool.gen, 1, memory_order_release);
+	Futex(&pool.gen, FUTEX_WAKE_PRIVATE, INT32_MAX);
+	for(i = 0; i < pool.nworkers; i++)
+		pthread_join(pool.threads[i], NULL);
+	pool.nworkers = 0;
+}
+
+int ForkJoin_ParseCpus(const char *list, int *cpus, int max)
+{
+	char *end;
+	long a, b;
+	int n = 0;
+
+	while(*list) {
+		a = strtol(list, &end, 10);
+		if(end == list || a < 0 || a >= CPU_SETSIZE)
+			return -1;
+		b = a;
+		if(*end == '-') {
+			list = end + 1;
+			b = strtol(list, &end, 10);
+			if(end == list || b < a || b >= CPU_SETSIZE)
+				return -1;
+		}
+		for(; a <= b; a++) {
+			if(n >= max)
+				return -1;
+			cpus[n++] = (int)a;
+		}
+		if(*end == ',')
+			end++;
+		else if(*end != '\0')
+			return -1;
+		list = end;
+	}
+	return n;
+}
@@ -0,0 +1,40 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Parallel (fork-join) Heavy_Work
+ *
+ * A pool of worker threads, created once and pinned to the given
+ * CPUs, shares each integration with the calling task: the range is
+ * split in nworkers+1 contiguous slices, the caller computes the
+ * first one and the workers the others. Workers wait for a job
+ * spinning for a while and then sleeping on a futex, so there is no
+ * thread creation nor locking per activation. The partial results
+ * are added by the caller always in slice order, so the result is
+ * deterministic (and equal to the serial one, to the rounding of
+ * the slice boundaries).
+ *
+ * ForkJoin_Kernel() has the signature of the integration kernels
+ * (see integKernel.h), so it can be used wherever Integ_Kernel is.
+ * There is one pool per process, used by one task at a time.
+ *
+ *****************************************************************/
+
+#ifndef FORK_JOIN_H
+#define FORK_JOIN_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define FJ_MAX_WORKERS 63		// Workers in the pool (the caller is one more)
+#define FJ_SPIN_ITERS 20000		// Polls before sleeping on the futex
+#define FJ_MIN_SLICE 1024		// Smaller jobs are not split
+
+int ForkJoin_Start(const int *cpus, int nworkers, int policy, int priority);
+double ForkJoin_Kernel(float lower, float upper, int subInterval);
+int ForkJoin_Workers(void);
+void ForkJoin_Stop(void);
+
+/* Parses a CPU list like "1,2,5-7". Returns the number of CPUs or -1 */
+int ForkJoin_ParseCpus(const char *list, int *cpus, int max);
+
+#endif
@@ -0,0 +1,128 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Benchmark for the parallel (fork-join) Heavy_Work
+ *
+ * Usage: forkJoinBench [-c CPULIST] [-p PRIORITY] [SUBINTERVAL [ACTIVATIONS]]
+ *		The calling thread runs on CPU 0 and, for 0, 1, 2, ... workers
+ *		(pinned to the CPUs of CPULIST, by default all the others),
+ *		times each activation and prints the execution time
+ *		distribution, the speedup over the serial kernel, the added
+ *		jitter (p99 - p50, relative to the serial one) and the
+ *		difference of the result to the serial one. With -p, the
+ *		caller and the workers run under SCHED_FIFO.
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "integKernel.h"
+#include "forkJoin.h"
+#include "hdrHist.h"
+
+#define NS_IN_SEC 1000000000L
+#define LOWER 0
+#define UPPER 100
+#define WARMUP 10
+
+struct hdrHist exec_hist;
+
+static uint64_t Now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * NS_IN_SEC + t.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	int cpus[FJ_MAX_WORKERS], ncpus, prio = 0, policy = SCHED_OTHER;
+	int subInterval, acts, opt, w, i, err, usage = 0;
+	char *cpulist = NULL;
+	double value = 0, serial = 0, serialMean = 0, serialSpread = 0, mean, spread;
+	struct sched_param parm;
+	cpu_set_t cpuset;
+	uint64_t t0;
+
+	while((opt = getopt(argc, argv, "c:p:")) != -1) {
+		switch(opt) {
+			case 'c':
+				cpulist = optarg;
+				break;
+			case 'p':
+				prio = atoi(optarg);
+				policy = SCHED_FIFO;
+				break;
+			default:
+				usage = 1;
+				break;
+		}
+	}
+	subInterval = optind < argc ? atoi(argv[optind]) : 1000000;
+	acts = optind + 1 < argc ? atoi(argv[optind + 1]) : 200;
+	if(cpulist != NULL)
+		ncpus = ForkJoin_ParseCpus(cpulist, cpus, FJ_MAX_WORKERS);
+	else // Default: every other online CPU
+		for(ncpus = 0, i = 1; i < sysconf(_SC_NPROCESSORS_ONLN) && ncpus < FJ_MAX_WORKERS; i++)
+			cpus[ncpus++] = i;
+	if(usage || subInterval < 2 || acts < 1 || ncpus < 0) {
+		printf("Usage: %s [-c CPULIST] [-p PRIORITY] [SUBINTERVAL [ACTIVATIONS]]\n", argv[0]);
+		return 1;
+	}
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(0, &cpuset);
+	sched_setaffinity(0, sizeof(cpuset), &cpuset);
+	if(policy == SCHED_FIFO) {
+		parm.sched_priority = prio;
+		if(sched_setscheduler(0, SCHED_FIFO, &parm))
+			perror("sched_setscheduler (running as SCHED_OTHER)");
+	}
+
+	printf("Kernel %s, subInterval=%d, %d activations, caller on CPU 0\n",
+		IntegKernel_Select(), subInterval, acts);
+	printf("%-8s %10s %10s %10s %10s %8s %12s %12s\n", "workers", "mean(us)", "p50(us)", "p99(us)",
+		"max(us)", "speedup", "jitter(us)", "result diff");
+
+	for(w = 0; w <= ncpus; w++) {
+		if(w > 0) {
+			err = ForkJoin_Start(cpus, w, policy, prio);
+			if(err) {
+				printf("%-8d could not start the workers (%s)\n", w, strerror(-err));
+				break;
+			}
+		}
+
+		HdrHist_Init(&exec_hist, HDR_DEFAULT_PRECISION_BITS);
+		for(i = 0; i < WARMUP + acts; i++) {
+			t0 = Now_ns();
+			value = ForkJoin_Kernel(LOWER, UPPER, subInterval);
+			if(i >= WARMUP)
+				HdrHist_Record(&exec_hist, Now_ns() - t0);
+		}
+		ForkJoin_Stop();
+
+		mean = HdrHist_Mean(&exec_hist);
+		spread = (double)HdrHist_Percentile(&exec_hist, 99.0) - HdrHist_Percentile(&exec_hist, 50.0);
+		if(w == 0) {
+			serial = value;
+			serialMean = mean;
+			serialSpread = spread;
+		}
+		printf("%-8d %10.3f %10.3f %10.3f %10.3f %8.2f %+12.3f %12.3e\n", w, mean / 1000,
+			(double)HdrHist_Percentile(&exec_hist, 50.0) / 1000,
+			(double)HdrHist_Percentile(&exec_hist, 99.0) / 1000,
+			(double)exec_hist.max / 1000, serialMean / mean,
+			(spread - serialSpread) / 1000, fabs(value - serial));
+	}
+	return 0;
+}
@@ -0,0 +1,159 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * High dynamic range (HDR) latency histogram - implementation
+ * See hdrHist.h for the bucket layout.
+ *
+ *****************************************************************/
+
+#include <string.h>
+#include <errno.h>
+
+#include "hdrHist.h"
+
+#define HDR_MAX_VALUE ((UINT64_C(1) << HDR_MAX_VALUE_BITS) - 1)
+
+/* Maps a value to its counter. Values below subCount are stored
+ * exactly; above that, bucket "b" keeps the precisionBits most
+ * significant bits of the value */
+static inline uint32_t HdrHist_Index(const struct hdrHist *h, uint64_t v)
+{
+	int msb, b;
+
+	if(v < h->subCount)
+		return (uint32_t)v;
+
+	msb = 63 - __builtin_clzll(v);
+	b = msb - h->precisionBits + 1;
+	return ((uint32_t)b << (h->precisionBits - 1)) + (uint32_t)(v >> b);
+}
+
+/* Highest value that maps to counter "idx" */
+static uint64_t HdrHist_HighestEquivalent(const struct hdrHist *h, uint32_t idx)
+{
+	int b;
+	uint64_t sub;
+
+	if(idx < h->subCount)
+		return idx;
+
+	b = (int)(idx >> (h->precisionBits - 1)) - 1;
+	sub = idx - ((uint64_t)b << (h->precisionBits - 1));
+	return ((sub + 1) << b) - 1;
+}
+
+int HdrHist_Init(struct hdrHist *h, int precisionBits)
+{
+	if(precisionBits < HDR_MIN_PRECISION_BITS || precisionBits > HDR_MAX_PRECISION_BITS)
+		return -EINVAL;
+
+	h->precisionBits = precisionBits;
+	h->subCount = UINT32_C(1) << precisionBits;
+	h->countsLen = (HDR_MAX_VALUE_BITS - precisionBits + 2) << (precisionBits - 1);
+	HdrHist_Reset(h);
+	return 0;
+}
+
+void HdrHist_Reset(struct hdrHist *h)
+{
+	h->total = 0;
+	h->saturated = 0;
+	h->min = UINT64_MAX;
+	h->max = 0;
+	h->sum = 0;
+	memset(h->counts, 0, sizeof(h->counts));
+}
+
+void HdrHist_Record(struct hdrHist *h, uint64_t value_ns)
+{
+	if(value_ns > HDR_MAX_VALUE) {
+		value_ns = HDR_MAX_VALUE;
+		h->saturated++;
+	}
+
+	h->counts[HdrHist_Index(h, value_ns)]++;
+	h->total++;
+	h->sum += value_ns;
+	if(value_ns < h->min)
+		h->min = value_ns;
+	if(value_ns > h->max)
+		h->max = value_ns;
+}
+
+/* Returns the smallest recorded value (to the histogram resolution)
+ * such that "percentile" % of the samples are less or equal to it */
+uint64_t HdrHist_Percentile(const struct hdrHist *h, double percentile)
+{
+	uint64_t target, acc = 0;
+	int i;
+
+	if(h->total == 0)
+		return 0;
+	if(percentile <= 0.0)
+		return h->min;
+	if(percentile >= 100.0)
+		return h->max;
+
+	target = (uint64_t)(percentile / 100.0 * (double)h->total + 0.5);
+	if(target == 0)
+		target = 1;
+
+	for(i = 0; i < h->countsLen; i++) {
+		acc += h->counts[i];
+		if(acc >= target) {
+			uint64_t v = HdrHist_HighestEquivalent(h, i);
+			return v > h->max ? h->max : v;
+		}
+	}
+	return h->max;
+}
+
+double HdrHist_Mean(const struct hdrHist *h)
+{
+	return h->total ? (double)h->sum / (double)h->total : 0.0;
+}
+
+/* Prints a one-line summary, values in us */
+void HdrHist_Print(const struct hdrHist *h, const char *name, FILE *out)
+{
+	if(h->total == 0) {
+		fprintf(out, "%s: no samples\n", name);
+		return;
+	}
+
+	fprintf(out, "%s (us): n=%llu min: %.3f mean: %.3f p50: %.3f p90: %.3f p99: %.3f p99.9: %.3f p99.99: %.3f max: %.3f",
+		name, (unsigned long long)h->total,
+		(double)h->min / 1000, HdrHist_Mean(h) / 1000,
+		(double)HdrHist_Percentile(h, 50.0) / 1000,
+		(double)HdrHist_Percentile(h, 90.0) / 1000,
+		(double)HdrHist_Percentile(h, 99.0) / 1000,
+		(double)HdrHist_Percentile(h, 99.9) / 1000,
+		(double)HdrHist_Percentile(h, 99.99) / 1000,
+		(double)h->max / 1000);
+	if(h->saturated)
+		fprintf(out, " (%llu saturated)", (unsigned long long)h->saturated);
+	fprintf(out, "\n");
+}
+
+/* Prints the histogram as a JSON object: summary (ns) and the non-empty
+ * counters as [highest value, count] pairs */
+void HdrHist_PrintJson(const struct hdrHist *h, FILE *out)
+{
+	const char *sep = "";
+	int i;
+
+	fprintf(out, "{\"unit\": \"ns\", \"count\": %llu, \"min\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, "
+		"\"p99\": %llu, \"p99.9\": %llu, \"p99.99\": %llu, \"max\": %llu, \"saturated\": %llu, \"buckets\": [",
+		(unsigned long long)h->total, (unsigned long long)(h->total ? h->min : 0), HdrHist_Mean(h),
+		(unsigned long long)HdrHist_Percentile(h, 50.0), (unsigned long long)HdrHist_Percentile(h, 90.0),
+		(unsigned long long)HdrHist_Percentile(h, 99.0), (unsigned long long)HdrHist_Percentile(h, 99.9),
+		(unsigned long long)HdrHist_Percentile(h, 99.99), (unsigned long long)h->max,
+		(unsigned long long)h->saturated);
+	for(i = 0; i < h->countsLen; i++) {
+		if(h->counts[i] == 0)
+			continue;
+		fprintf(out, "%s[%llu, %u]", sep, (unsigned long long)HdrHist_HighestEquivalent(h, i), h->counts[i]);
+		sep = ", ";
+	}
+	fprintf(out, "]}");
+}
@@ -0,0 +1,52 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * High dynamic range (HDR) latency histogram
+ *
+ * Log-linear histogram for time intervals expressed in ns, covering
+ * 1 ns up to 2^HDR_MAX_VALUE_BITS ns (~68 s). Each power-of-two range
+ * is split in 2^(precision_bits-1) linear sub-buckets, so the relative
+ * error of any reported value is below 2^-(precision_bits-1)
+ * (e.g. precision_bits=10 -> ~0.2%).
+ *
+ * The counters live inside the structure (fixed memory), so recording
+ * never allocates, locks or makes a syscall and can be done from the
+ * periodic loop of a RT task. Queries and printing are meant to be
+ * done outside the periodic loop (e.g. on exit).
+ *
+ *****************************************************************/
+
+#ifndef HDR_HIST_H
+#define HDR_HIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HDR_MAX_VALUE_BITS 36		// Largest value recorded is 2^36-1 ns (~68 s)
+#define HDR_MIN_PRECISION_BITS 2	// Coarsest resolution: one sub-bucket per octave half
+#define HDR_MAX_PRECISION_BITS 12	// Finest resolution: ~0.05% relative error
+#define HDR_DEFAULT_PRECISION_BITS 10	// ~0.2% relative error
+
+/* Number of counters needed for the finest precision */
+#define HDR_COUNTS_LEN ((HDR_MAX_VALUE_BITS - HDR_MAX_PRECISION_BITS + 3) << (HDR_MAX_PRECISION_BITS - 1))
+
+struct hdrHist {
+	int precisionBits;		// Configured precision (bits)
+	uint32_t subCount;		// 2^precisionBits
+	int countsLen;			// Counters actually in use
+	uint64_t total;			// Number of recorded values
+	uint64_t saturated;		// Values above the histogram range (clamped)
+	uint64_t min, max;		// Exact extremes of the recorded values
+	uint64_t sum;			// Sum of recorded values, for the mean
+	uint32_t counts[HDR_COUNTS_LEN];
+};
+
+int HdrHist_Init(struct hdrHist *h, int precisionBits);
+void HdrHist_Reset(struct hdrHist *h);
+void HdrHist_Record(struct hdrHist *h, uint64_t value_ns);
+uint64_t HdrHist_Percentile(const struct hdrHist *h, double percentile);
+double HdrHist_Mean(const struct hdrHist *h);
+void HdrHist_Print(const struct hdrHist *h, const char *name, FILE *out);
+void HdrHist_PrintJson(const struct hdrHist *h, FILE *out);
+
+#endif
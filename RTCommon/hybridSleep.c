@@ -0,0 +1,104 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Hybrid sleep-then-spin wakeup - implementation
+ *
+ *****************************************************************/
+
+#include "hybridSleep.h"
+#include "tsClock.h"
+
+#define NS_IN_SEC 1000000000L
+
+static int64_t Now_ns(void)
+{
+	return TsClock_Now_ns();
+}
+
+/* Enables the hybrid mode with a fixed guard, or with auto tuning
+ * when guard_ns is 0 */
+void HybridSleep_Init(struct hybridSleep *hs, int enabled, int64_t guard_ns, uint64_t period_ns)
+{
+	hs->enabled = enabled;
+	hs->autoTune = guard_ns == 0;
+	hs->guard_ns = guard_ns ? guard_ns : HS_INITIAL_GUARD_NS;
+	hs->winMax_ns = 0;
+	hs->wakeups = hs->late = hs->spin_ns = 0;
+	hs->period_ns = period_ns;
+	HdrHist_Init(&hs->wakeLat, HDR_DEFAULT_PRECISION_BITS);
+	HdrHist_Init(&hs->spin, HDR_DEFAULT_PRECISION_BITS);
+}
+
+static void Tune(struct hybridSleep *hs, int64_t lat, int wasLate)
+{
+	int64_t g;
+
+	if(lat > hs->winMax_ns)
+		hs->winMax_ns = lat;
+
+	if(wasLate)
+		g = 2 * hs->guard_ns;
+	else if(hs->wakeups % HS_TUNE_WINDOW == 0) {
+		g = hs->winMax_ns + HS_GUARD_MARGIN_NS;
+		if(g < hs->guard_ns)
+			g = (7 * hs->guard_ns + g) / 8;
+		hs->winMax_ns = 0;
+	} else
+		return;
+
+	if(g < HS_MIN_GUARD_NS)
+		g = HS_MIN_GUARD_NS;
+	if(g > HS_MAX_GUARD_NS)
+		g = HS_MAX_GUARD_NS;
+	hs->guard_ns = g;
+}
+
+/* Returns at the absolute release time (CLOCK_MONOTONIC) */
+void HybridSleep_Until(struct hybridSleep *hs, const struct timespec *release)
+{
+	struct timespec target;
+	int64_t rel, t, t0;
+
+	if(!hs->enabled) {
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, release, NULL);
+		return;
+	}
+
+	rel = (int64_t)release->tv_sec * NS_IN_SEC + release->tv_nsec;
+	t = Now_ns();
+	if(t >= rel - hs->guard_ns) { // Late (overrun) or too close to sleep: not a wakeup sample
+		while(t < rel)
+			t = Now_ns();
+		return;
+	}
+
+	target.tv_sec = (rel - hs->guard_ns) / NS_IN_SEC;
+	target.tv_nsec = (rel - hs->guard_ns) % NS_IN_SEC;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+
+	t0 = t = Now_ns();
+	hs->wakeups++;
+	HdrHist_Record(&hs->wakeLat, t0 > rel - hs->guard_ns ? t0 - (rel - hs->guard_ns) : 0);
+	if(t0 >= rel)
+		hs->late++;
+	while(t < rel)
+		t = Now_ns();
+	hs->spin_ns += t - t0;
+	HdrHist_Record(&hs->spin, t - t0);
+
+	if(hs->autoTune)
+		Tune(hs, t0 - (rel - hs->guard_ns), t0 >= rel);
+}
+
+void HybridSleep_Print(const struct hybridSleep *hs, const char *name, FILE *out)
+{
+	if(!hs->enabled)
+		return;
+
+	fprintf(out, "%s hybrid wakeup: guard %.3f us (%s), %llu wakeups, %llu after the release, polling %.3f%% of the CPU\n",
+		name, (double)hs->guard_ns / 1000, hs->autoTune ? "auto" : "fixed",
+		(unsigned long long)hs->wakeups, (unsigned long long)hs->late,
+		hs->wakeups && hs->period_ns ? 100.0 * hs->spin_ns / ((double)hs->wakeups * hs->period_ns) : 0.0);
+	HdrHist_Print(&hs->wakeLat, "  Sleep wakeup latency (plain clock_nanosleep)", out);
+	HdrHist_Print(&hs->spin, "  Polling time", out);
+}
@@ -0,0 +1,50 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Hybrid sleep-then-spin wakeup
+ *
+ * HybridSleep_Until() sleeps with clock_nanosleep until "guard" ns
+ * before the release and then polls the clock until the release
+ * itself, so the release latency no longer depends on the timer
+ * wakeup latency, at the cost of the CPU time spent polling.
+ *
+ * With auto tuning the guard follows the observed wakeup latency:
+ * it is set to the worst wakeup latency of the last HS_TUNE_WINDOW
+ * wakeups plus HS_GUARD_MARGIN_NS, it grows at once (doubles on a
+ * wakeup after the release) and shrinks slowly.
+ *
+ *****************************************************************/
+
+#ifndef HYBRID_SLEEP_H
+#define HYBRID_SLEEP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "hdrHist.h"
+
+#define HS_INITIAL_GUARD_NS (50*1000)	// Starting guard with auto tuning
+#define HS_MIN_GUARD_NS (1*1000)
+#define HS_MAX_GUARD_NS (1000*1000)
+#define HS_GUARD_MARGIN_NS (2*1000)
+#define HS_TUNE_WINDOW 64		// Wakeups between guard updates
+
+struct hybridSleep {
+	int enabled;			// 0: plain clock_nanosleep
+	int autoTune;
+	int64_t guard_ns;		// Current guard interval
+	int64_t winMax_ns;		// Worst wakeup latency of the current window
+	uint64_t wakeups;
+	uint64_t late;			// Wakeups already after the release
+	uint64_t spin_ns;		// CPU time spent polling
+	uint64_t period_ns;		// For the CPU overhead report
+	struct hdrHist wakeLat;		// Wakeup latency of the sleep (vs its own target)
+	struct hdrHist spin;		// Polling time per activation
+};
+
+void HybridSleep_Init(struct hybridSleep *hs, int enabled, int64_t guard_ns, uint64_t period_ns);
+void HybridSleep_Until(struct hybridSleep *hs, const struct timespec *release);
+void HybridSleep_Print(const struct hybridSleep *hs, const char *name, FILE *out);
+
+#endif
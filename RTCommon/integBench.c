@@ -0,0 +1,92 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Microbenchmark for the Heavy_Work integration kernels
+ *
+ * Usage: integBench [SUBINTERVAL [REPETITIONS]]
+ *		For the original pow() based loop and each kernel supported
+ *		by the CPU, prints the cost per function evaluation, the
+ *		speedup against the original code and the error against the
+ *		scalar (double precision) reference.
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "integKernel.h"
+
+#define NS_IN_SEC 1000000000L
+#define LOWER 0
+#define UPPER 100
+
+/* The loop Heavy_Work used before the kernels, kept as baseline */
+#define f(x) 1/(1+pow(x,2))
+static double Integ_Original(float lower, float upper, int subInterval)
+{
+	float integration, stepSize, k;
+	int i;
+
+	stepSize = (upper - lower)/subInterval;
+	integration = f(lower) + f(upper);
+	for(i=1; i<= subInterval-1; i++) {
+		k = lower + i*stepSize;
+		integration = integration + 2 * f(k);
+	}
+	return integration * stepSize/2;
+}
+
+static double Now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec * NS_IN_SEC + t.tv_nsec;
+}
+
+/* Returns the mean ns per evaluation of f() */
+static double Bench(integKernelFn fn, int subInterval, int reps, double *value)
+{
+	double t0;
+	int r;
+
+	*value = fn(LOWER, UPPER, subInterval); // Warm-up
+	t0 = Now_ns();
+	for(r = 0; r < reps; r++)
+		*value = fn(LOWER, UPPER, subInterval);
+	return (Now_ns() - t0) / ((double)reps * (subInterval + 1));
+}
+
+int main(int argc, char *argv[])
+{
+	int subInterval = argc > 1 ? atoi(argv[1]) : 200000;
+	int reps = argc > 2 ? atoi(argv[2]) : 50;
+	double ref, value, base, ns;
+	int i;
+
+	if(subInterval < 2 || reps < 1) {
+		printf("Usage: %s [SUBINTERVAL [REPETITIONS]]\n", argv[0]);
+		return 1;
+	}
+
+	ref = Integ_Scalar(LOWER, UPPER, subInterval);
+	printf("subInterval=%d, %d repetitions, reference value %.9f (exact %.9f)\n",
+		subInterval, reps, ref, atan(UPPER) - atan(LOWER));
+	printf("%-10s %12s %10s %14s %12s\n", "kernel", "ns/eval", "speedup", "value", "abs error");
+
+	base = Bench(Integ_Original, subInterval, reps, &value);
+	printf("%-10s %12.3f %10.2f %14.9f %12.3e\n", "original", base, 1.0, value, fabs(value - ref));
+
+	for(i = 0; integKernels[i].name != NULL; i++) {
+		if(!integKernels[i].supported()) {
+			printf("%-10s %12s\n", integKernels[i].name, "unsupported");
+			continue;
+		}
+		ns = Bench(integKernels[i].fn, subInterval, reps, &value);
+		printf("%-10s %12.3f %10.2f %14.9f %12.3e\n", integKernels[i].name, ns, base / ns, value, fabs(value - ref));
+	}
+	printf("Selected for Heavy_Work: %s\n", IntegKernel_Select());
+	return 0;
+}
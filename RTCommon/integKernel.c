@@ -0,0 +1,204 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Numerical integration kernels - implementation
+ *
+ * The vector kernels are compiled with per-function target
+ * attributes, so the file builds with the default compiler flags
+ * and the ISA is only required at run time, after the CPUID check.
+ *
+ *****************************************************************/
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INTEG_X86 1
+#endif
+
+#include "integKernel.h"
+
+#define NACC 4	// Independent vector accumulators in the SIMD kernels
+
+static inline float f(float x)
+{
+	return 1.0f / (1.0f + x * x);
+}
+
+/* Adds the contribution of points first..last (inclusive) */
+static double Tail(float lower, float stepSize, int first, int last)
+{
+	double sum = 0.0;
+	int i;
+
+	for(i = first; i <= last; i++)
+		sum += f(lower + i * stepSize);
+	return sum;
+}
+
+/* Reference kernel: same algorithm as the original Heavy_Work, in double
+ * precision and without pow() */
+double Integ_Scalar(float lower, float upper, int subInterval)
+{
+	double stepSize = ((double)upper - lower) / subInterval, x, sum = 0.0;
+	int i;
+
+	for(i = 1; i <= subInterval - 1; i++) {
+		x = lower + i * stepSize;
+		sum += 1.0 / (1.0 + x * x);
+	}
+	x = upper;
+	sum = 2 * sum + 1.0 / (1.0 + (double)lower * lower) + 1.0 / (1.0 + x * x);
+	return sum * stepSize / 2;
+}
+
+#ifdef INTEG_X86
+
+double Integ_Sse2(float lower, float upper, int subInterval)
+{
+	float stepSize = (upper - lower) / subInterval;
+	__m128 acc[NACC], x, vlow = _mm_set1_ps(lower), vstep = _mm_set1_ps(stepSize), one = _mm_set1_ps(1.0f);
+	__m128i idx = _mm_setr_epi32(1, 2, 3, 4), inc = _mm_set1_epi32(4);
+	float lanes[4];
+	double sum = 0.0;
+	int i, j, last = subInterval - 1;
+
+	for(j = 0; j < NACC; j++)
+		acc[j] = _mm_setzero_ps();
+
+	for(i = 1; i + 4 * NACC - 1 <= last; i += 4 * NACC) {
+		for(j = 0; j < NACC; j++) {
+			x = _mm_add_ps(vlow, _mm_mul_ps(_mm_cvtepi32_ps(idx), vstep));
+			acc[j] = _mm_add_ps(acc[j], _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(x, x))));
+			idx = _mm_add_epi32(idx, inc);
+		}
+	}
+
+	acc[0] = _mm_add_ps(_mm_add_ps(acc[0], acc[1]), _mm_add_ps(acc[2], acc[3]));
+	_mm_storeu_ps(lanes, acc[0]);
+	for(j = 0; j < 4; j++)
+		sum += lanes[j];
+	sum += Tail(lower, stepSize, i, last);
+
+	return (f(lower) + f(upper) + 2 * sum) * stepSize / 2;
+}
+
+__attribute__((target("avx2,fma")))
+double Integ_Avx2(float lower, float upper, int subInterval)
+{
+	float stepSize = (upper - lower) / subInterval;
+	__m256 acc[NACC], x, vlow = _mm256_set1_ps(lower), vstep = _mm256_set1_ps(stepSize), one = _mm256_set1_ps(1.0f);
+	__m256i idx = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8), inc = _mm256_set1_epi32(8);
+	float lanes[8];
+	double sum = 0.0;
+	int i, j, last = subInterval - 1;
+
+	for(j = 0; j < NACC; j++)
+		acc[j] = _mm256_setzero_ps();
+
+	for(i = 1; i + 8 * NACC - 1 <= last; i += 8 * NACC) {
+		for(j = 0; j < NACC; j++) {
+			x = _mm256_fmadd_ps(_mm256_cvtepi32_ps(idx), vstep, vlow);
+			acc[j] = _mm256_add_ps(acc[j], _mm256_div_ps(one, _mm256_fmadd_ps(x, x, one)));
+			idx = _mm256_add_epi32(idx, inc);
+		}
+	}
+
+	acc[0] = _mm256_add_ps(_mm256_add_ps(acc[0], acc[1]), _mm256_add_ps(acc[2], acc[3]));
+	_mm256_storeu_ps(lanes, acc[0]);
+	for(j = 0; j < 8; j++)
+		sum += lanes[j];
+	sum += Tail(lower, stepSize, i, last);
+
+	return (f(lower) + f(upper) + 2 * sum) * stepSize / 2;
+}
+
+__attribute__((target("avx512f")))
+double Integ_Avx512(float lower, float upper, int subInterval)
+{
+	float stepSize = (upper - lower) / subInterval;
+	__m512 acc[NACC], x, vlow = _mm512_set1_ps(lower), vstep = _mm512_set1_ps(stepSize), one = _mm512_set1_ps(1.0f);
+	__m512i idx = _mm512_setr_epi32(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16), inc = _mm512_set1_epi32(16);
+	float lanes[16];
+	double sum = 0.0;
+	int i, j, last = subInterval - 1;
+
+	for(j = 0; j < NACC; j++)
+		acc[j] = _mm512_setzero_ps();
+
+	for(i = 1; i + 16 * NACC - 1 <= last; i += 16 * NACC) {
+		for(j = 0; j < NACC; j++) {
+			x = _mm512_fmadd_ps(_mm512_cvtepi32_ps(idx), vstep, vlow);
+			acc[j] = _mm512_add_ps(acc[j], _mm512_div_ps(one, _mm512_fmadd_ps(x, x, one)));
+			idx = _mm512_add_epi32(idx, inc);
+		}
+	}
+
+	acc[0] = _mm512_add_ps(_mm512_add_ps(acc[0], acc[1]), _mm512_add_ps(acc[2], acc[3]));
+	_mm512_storeu_ps(lanes, acc[0]);
+	for(j = 0; j < 16; j++)
+		sum += lanes[j];
+	sum += Tail(lower, stepSize, i, last);
+
+	return (f(lower) + f(upper) + 2 * sum) * stepSize / 2;
+}
+
+static int Supported_Sse2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+}
+
+static int Supported_Avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+static int Supported_Avx512(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx512f");
+}
+
+#else /* Non x86 targets: only the scalar kernel is available */
+
+double Integ_Sse2(float lower, float upper, int subInterval) { return Integ_Scalar(lower, upper, subInterval); }
+double Integ_Avx2(float lower, float upper, int subInterval) { return Integ_Scalar(lower, upper, subInterval); }
+double Integ_Avx512(float lower, float upper, int subInterval) { return Integ_Scalar(lower, upper, subInterval); }
+
+static int Supported_Sse2(void) { return 0; }
+static int Supported_Avx2(void) { return 0; }
+static int Supported_Avx512(void) { return 0; }
+
+#endif
+
+static int Supported_Always(void)
+{
+	return 1;
+}
+
+const struct integKernel integKernels[] = {
+	{ "scalar", Integ_Scalar, Supported_Always },
+	{ "sse2", Integ_Sse2, Supported_Sse2 },
+	{ "avx2", Integ_Avx2, Supported_Avx2 },
+	{ "avx512", Integ_Avx512, Supported_Avx512 },
+	{ NULL, NULL, NULL }
+};
+
+integKernelFn Integ_Kernel = Integ_Scalar;
+
+/* Selects the widest kernel supported by the CPU. Returns its name */
+const char *IntegKernel_Select(void)
+{
+	const char *name = integKernels[0].name;
+	int i;
+
+	for(i = 0; integKernels[i].name != NULL; i++) {
+		if(integKernels[i].supported()) {
+			Integ_Kernel = integKernels[i].fn;
+			name = integKernels[i].name;
+		}
+	}
+	return name;
+}
@@ -0,0 +1,40 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Numerical integration kernels used as task load (Heavy_Work)
+ *
+ * Trapezoidal integration of f(x) = 1/(1+x^2) over [lower, upper]
+ * with "subInterval" sub-intervals. Besides the scalar reference
+ * (double precision, used for accuracy checks) there are SSE2, AVX2
+ * and AVX-512 versions that evaluate several points per instruction
+ * and keep several partial accumulators to hide the latency of the
+ * additions. IntegKernel_Select() picks the widest one supported by
+ * the CPU (CPUID), once, at startup.
+ *
+ *****************************************************************/
+
+#ifndef INTEG_KERNEL_H
+#define INTEG_KERNEL_H
+
+typedef double (*integKernelFn)(float lower, float upper, int subInterval);
+
+struct integKernel {
+	const char *name;
+	integKernelFn fn;
+	int (*supported)(void);
+};
+
+double Integ_Scalar(float lower, float upper, int subInterval);
+double Integ_Sse2(float lower, float upper, int subInterval);
+double Integ_Avx2(float lower, float upper, int subInterval);
+double Integ_Avx512(float lower, float upper, int subInterval);
+
+/* All kernels, from the reference to the widest ISA (NULL terminated) */
+extern const struct integKernel integKernels[];
+
+/* Kernel selected by IntegKernel_Select() (scalar until then) */
+extern integKernelFn Integ_Kernel;
+
+const char *IntegKernel_Select(void);
+
+#endif
@@ -0,0 +1,267 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Interference generator (co-runner stress) - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "interference.h"
+#include "forkJoin.h"
+
+#define NS_IN_SEC 1000000000L
+#define LINE 64
+#define PAGE 4096
+#define CACHE_STEP (64*1024)	// Bytes streamed between duty cycle checks
+#define CPU_STEP 1000		// Iterations between duty cycle checks
+
+enum intfType { INTF_CPU, INTF_CACHE, INTF_SYSCALL, INTF_PAGEFAULT, INTF_TYPES };
+
+static const char *typeNames[INTF_TYPES] = { "cpu", "cache", "syscall", "pagefault" };
+
+struct intfThread {
+	int spec;			// Index of the spec that created it
+	int cpu;
+	pthread_t thread;
+	char *buf;			// Cache thread buffer
+	size_t pos;			// Next line of buf
+	uint64_t ops;			// Work done (see Interference_Print)
+};
+
+static struct {
+	struct {
+		enum intfType type;
+		int pct;
+		char text[64];		// Normalized spec, for Interference_Describe
+	} specs[INTF_MAX_SPECS];
+	int nspecs;
+	struct intfThread th[INTF_MAX_THREADS];
+	int nthreads;			// Threads configured
+	int running;			// Threads started
+	int devnull;
+	uint64_t start_ns, stop_ns;
+	volatile int stop;
+} intf;
+
+static uint64_t Now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * NS_IN_SEC + t.tv_nsec;
+}
+
+/* One unit of work of the thread's type */
+static void Step(struct intfThread *t)
+{
+	volatile double x = 1.0;
+	char *p;
+	int i;
+
+	switch(intf.specs[t->spec].type) {
+		case INTF_CPU:
+			for(i = 0; i < CPU_STEP; i++)
+				x = x * 1.0000001 + 1e-9;
+			t->ops += CPU_STEP;
+			break;
+		case INTF_CACHE:
+			for(i = 0; i < CACHE_STEP; i += LINE) {
+				t->buf[t->pos]++;
+				t->pos = (t->pos + LINE) % INTF_CACHE_BUF;
+			}
+			t->ops += CACHE_STEP / LINE;
+			break;
+		case INTF_SYSCALL:
+			syscall(SYS_getppid);
+			if(write(intf.devnull, "", 1) < 0)
+				break;
+			sched_yield();
+			t->ops += 3;
+			break;
+		case INTF_PAGEFAULT:
+			p = mmap(NULL, INTF_FAULT_BUF, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if(p == MAP_FAILED)
+				break;
+			for(i = 0; i < INTF_FAULT_BUF; i += PAGE)
+				p[i] = 1;
+			munmap(p, INTF_FAULT_BUF);
+			t->ops += INTF_FAULT_BUF / PAGE;
+			break;
+		default:
+			break;
+	}
+}
+
+/* Works pct % of every duty cycle period, sleeps the rest */
+static void *Generator_code(void *arg)
+{
+	struct intfThread *t = arg;
+	uint64_t period = INTF_DUTY_PERIOD_MS * 1000000ULL;
+	uint64_t on = period * intf.specs[t->spec].pct / 100, start;
+	struct timespec ts;
+
+	while(!intf.stop) {
+		start = Now_ns();
+		do
+			Step(t);
+		while(Now_ns() - start < on && !intf.stop);
+		if(on < period) {
+			ts.tv_sec = (start + period) / NS_IN_SEC;
+			ts.tv_nsec = (start + period) % NS_IN_SEC;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+	}
+	return NULL;
+}
+
+/* Adds the generator given by "spec" (TYPE[:PCT][@CPULIST], see
+ * interference.h); without a CPU list it runs on defaultCpu.
+ * Returns 0 or -EINVAL (bad spec), -ENOSPC (too many threads) */
+int Interference_Add(const char *spec, int defaultCpu)
+{
+	int cpus[INTF_MAX_THREADS], ncpus = 1, pct = 100, type, i;
+	const char *at = strchr(spec, '@');
+	size_t len = strcspn(spec, ":@");
+	char *end;
+
+	for(type = 0; type < INTF_TYPES; type++)
+		if(strlen(typeNames[type]) == len && !strncmp(spec, typeNames[type], len))
+			break;
+	if(type == INTF_TYPES)
+		return -EINVAL;
+	if(spec[len] == ':') {
+		pct = strtol(spec + len + 1, &end, 10);
+		if(end == spec + len + 1 || (*end != '\0' && *end != '@') || pct < 1 || pct > 100)
+			return -EINVAL;
+	}
+	cpus[0] = defaultCpu;
+	if(at != NULL)
+		ncpus = ForkJoin_ParseCpus(at + 1, cpus, INTF_MAX_THREADS);
+	if(ncpus <= 0)
+		return -EINVAL;
+	if(intf.nspecs == INTF_MAX_SPECS || intf.nthreads + ncpus > INTF_MAX_THREADS)
+		return -ENOSPC;
+
+	intf.specs[intf.nspecs].type = type;
+	intf.specs[intf.nspecs].pct = pct;
+	if(at != NULL)
+		snprintf(intf.specs[intf.nspecs].text, sizeof(intf.specs[0].text), "%s:%d@%s", typeNames[type], pct, at + 1);
+	else
+		snprintf(intf.specs[intf.nspecs].text, sizeof(intf.specs[0].text), "%s:%d@%d", typeNames[type], pct, defaultCpu);
+	for(i = 0; i < ncpus; i++) {
+		memset(&intf.th[intf.nthreads], 0, sizeof(intf.th[0]));
+		intf.th[intf.nthreads].spec = intf.nspecs;
+		intf.th[intf.nthreads].cpu = cpus[i];
+		intf.nthreads++;
+	}
+	intf.nspecs++;
+	return 0;
+}
+
+/* Starts the generators added so far (SCHED_OTHER). Returns 0 or -errno */
+int Interference_Start(void)
+{
+	pthread_attr_t attr;
+	struct sched_param parm = { .sched_priority = 0 };
+	cpu_set_t cpuset;
+	struct intfThread *t;
+	int err = 0;
+
+	if(intf.nthreads == 0)
+		return 0;
+	intf.stop = 0;
+	intf.devnull = open("/dev/null", O_WRONLY);
+	if(intf.devnull < 0)
+		return -errno;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &parm);
+	for(intf.running = 0; intf.running < intf.nthreads; intf.running++) {
+		t = &intf.th[intf.running];
+		if(intf.specs[t->spec].type == INTF_CACHE) {
+			t->buf = calloc(1, INTF_CACHE_BUF);
+			if(t->buf == NULL) {
+				err = ENOMEM;
+				break;
+			}
+		}
+		CPU_ZERO(&cpuset);
+		CPU_SET(t->cpu, &cpuset);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+		err = pthread_create(&t->thread, &attr, Generator_code, t);
+		if(err) {
+			free(t->buf);
+			t->buf = NULL;
+			break;
+		}
+	}
+	pthread_attr_destroy(&attr);
+	intf.start_ns = Now_ns();
+
+	if(err) {
+		Interference_Stop();
+		return -err;
+	}
+	return 0;
+}
+
+/* Stops the generators (the work counters are kept for Interference_Print) */
+void Interference_Stop(void)
+{
+	int i;
+
+	if(intf.running == 0)
+		return;
+	intf.stop = 1;
+	for(i = 0; i < intf.running; i++) {
+		pthread_join(intf.th[i].thread, NULL);
+		free(intf.th[i].buf);
+		intf.th[i].buf = NULL;
+	}
+	intf.running = 0;
+	intf.stop_ns = Now_ns();
+	close(intf.devnull);
+}
+
+/* The scenario, as the normalized specs joined by "+" ("none" if empty) */
+const char *Interference_Describe(char *buf, size_t size)
+{
+	size_t n = 0;
+	int i;
+
+	snprintf(buf, size, "none");
+	for(i = 0; i < intf.nspecs && n < size; i++)
+		n += snprintf(buf + n, size - n, "%s%s", i ? "+" : "", intf.specs[i].text);
+	return buf;
+}
+
+/* Work rate of each generator: loop iterations (cpu), cache lines
+ * (cache), syscalls (syscall) or pages faulted in (pagefault) per second */
+void Interference_Print(FILE *out)
+{
+	double secs = (double)(intf.stop_ns - intf.start_ns) / NS_IN_SEC;
+	uint64_t ops;
+	int s, i;
+
+	for(s = 0; s < intf.nspecs; s++) {
+		for(i = 0, ops = 0; i < intf.nthreads; i++)
+			if(intf.th[i].spec == s)
+				ops += intf.th[i].ops;
+		fprintf(out, "Interference %s: %.3e %s/s\n", intf.specs[s].text, secs > 0 ? ops / secs : 0.0,
+			intf.specs[s].type == INTF_CPU ? "iterations" : intf.specs[s].type == INTF_CACHE ? "lines" :
+			intf.specs[s].type == INTF_SYSCALL ? "syscalls" : "pages");
+	}
+}
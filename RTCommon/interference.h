@@ -0,0 +1,43 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Interference generator (co-runner stress)
+ *
+ * Background threads (SCHED_OTHER) that load the CPUs the RT task
+ * shares, to see how its latency degrades with each kind of noise:
+ *	cpu		busy arithmetic loop
+ *	cache		read-modify-write streaming over INTF_CACHE_BUF
+ *			(cache and memory bandwidth thrashing)
+ *	syscall		getppid/write(/dev/null)/sched_yield storm
+ *			(kernel entries, runqueue activity)
+ *	pagefault	mmap, touch every page, munmap
+ *			(page allocation, page table and TLB activity)
+ *
+ * Each generator is given as TYPE[:PCT][@CPULIST]: one thread on each
+ * CPU of the list (default: the CPU given to Interference_Add, e.g.
+ * the one of the RT task) that works PCT % (default 100) of every
+ * INTF_DUTY_PERIOD_MS and sleeps the rest. Interference_Describe()
+ * gives the active scenario, to be kept with the results.
+ *
+ *****************************************************************/
+
+#ifndef INTERFERENCE_H
+#define INTERFERENCE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define INTF_MAX_THREADS 64		// Generator threads, all specs together
+#define INTF_MAX_SPECS 8		// Specs (Interference_Add calls)
+#define INTF_DUTY_PERIOD_MS 10		// Duty cycle period of a generator
+#define INTF_CACHE_BUF (32*1024*1024)	// Buffer streamed by each cache thread
+#define INTF_FAULT_BUF (1024*1024)	// Mapping faulted in by each pagefault thread
+
+int Interference_Add(const char *spec, int defaultCpu);
+int Interference_Start(void);
+void Interference_Stop(void);
+const char *Interference_Describe(char *buf, size_t size);
+void Interference_Print(FILE *out);
+
+#endif
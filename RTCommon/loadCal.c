@@ -0,0 +1,143 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Self-calibrating synthetic load - implementation
+ *
+ *****************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+
+#include "loadCal.h"
+#include "tsClock.h"
+
+#define CAL_MIN_RUN_NS (1000*1000)	// Shortest run used to estimate the kernel cost
+#define CAL_RUNS 5			// Runs per measurement (the fastest is kept)
+
+static uint64_t Now_ns(void)
+{
+	return (uint64_t)TsClock_Now_ns();
+}
+
+/* Fastest of CAL_RUNS executions of the kernel with n sub-intervals */
+static uint64_t TimeKernel(integKernelFn kernel, int n)
+{
+	uint64_t t0, t, best = UINT64_MAX;
+	int r;
+
+	for(r = 0; r < CAL_RUNS; r++) {
+		t0 = Now_ns();
+		kernel(LOADCAL_LOWER, LOADCAL_UPPER, n);
+		t = Now_ns() - t0;
+		if(t < best)
+			best = t;
+	}
+	return best;
+}
+
+/* Iteration count that takes target_ns at the given cost */
+static int SubIntervalFor(uint64_t target_ns, double nsPerEval)
+{
+	double n = (double)target_ns / nsPerEval - 1;
+
+	if(n < LOADCAL_MIN_SUBINTERVAL)
+		return LOADCAL_MIN_SUBINTERVAL;
+	if(n > INT_MAX)
+		return INT_MAX;
+	return (int)n;
+}
+
+/* Calibrates the load for target_ns (must be called after
+ * IntegKernel_Select(), outside the periodic loop). Returns 0 or
+ * -EINVAL */
+int LoadCal_Init(struct loadCal *lc, uint64_t target_ns, int defaultSubInterval)
+{
+	return LoadCal_InitKernel(lc, Integ_Kernel, target_ns, defaultSubInterval);
+}
+
+int LoadCal_InitKernel(struct loadCal *lc, integKernelFn kernel, uint64_t target_ns, int defaultSubInterval)
+{
+	uint64_t t;
+	int n;
+
+	lc->kernel = kernel;
+	lc->target_ns = target_ns;
+	lc->subInterval = defaultSubInterval;
+	lc->nsPerEval = 0;
+	lc->jobs = lc->recalibrations = 0;
+	lc->min_ns = lc->winMin_ns = UINT64_MAX;
+	lc->max_ns = lc->sum_ns = 0;
+	lc->value = 0;
+	if(target_ns == 0)
+		return defaultSubInterval >= LOADCAL_MIN_SUBINTERVAL ? 0 : -EINVAL;
+
+	/* Grow the load until a run is long enough to be timed reliably */
+	for(n = 1024; ; n *= 2) {
+		t = TimeKernel(lc->kernel, n);
+		if(t >= CAL_MIN_RUN_NS || t >= target_ns || n >= INT_MAX / 2)
+			break;
+	}
+	lc->nsPerEval = (double)t / (n + 1);
+
+	/* Check at the final size (the cost per evaluation is not quite
+	 * constant: call overhead, caches, frequency) */
+	lc->subInterval = SubIntervalFor(target_ns, lc->nsPerEval);
+	t = TimeKernel(lc->kernel, lc->subInterval);
+	lc->nsPerEval = (double)t / (lc->subInterval + 1);
+	lc->subInterval = SubIntervalFor(target_ns, lc->nsPerEval);
+	return 0;
+}
+
+/* Executes one job (RT side). Returns the integration value */
+double LoadCal_Run(struct loadCal *lc)
+{
+	uint64_t t0, t;
+
+	t0 = Now_ns();
+	lc->value = lc->kernel(LOADCAL_LOWER, LOADCAL_UPPER, lc->subInterval);
+	t = Now_ns() - t0;
+
+	lc->jobs++;
+	lc->sum_ns += t;
+	if(t < lc->min_ns)
+		lc->min_ns = t;
+	if(t > lc->max_ns)
+		lc->max_ns = t;
+	if(t < lc->winMin_ns)
+		lc->winMin_ns = t;
+
+	/* Drift check, with the least disturbed job of the window */
+	if(lc->target_ns != 0 && lc->jobs % LOADCAL_WINDOW == 0) {
+		if(lc->winMin_ns * 100 > lc->target_ns * (100 + LOADCAL_DRIFT_PCT) ||
+		   lc->winMin_ns * 100 < lc->target_ns * (100 - LOADCAL_DRIFT_PCT)) {
+			lc->nsPerEval = (double)lc->winMin_ns / (lc->subInterval + 1);
+			lc->subInterval = SubIntervalFor(lc->target_ns, lc->nsPerEval);
+			lc->recalibrations++;
+		}
+		lc->winMin_ns = UINT64_MAX;
+	}
+	return lc->value;
+}
+
+/* Prints requested vs achieved execution time, values in us */
+void LoadCal_Print(const struct loadCal *lc, const char *name, FILE *out)
+{
+	if(lc->target_ns)
+		fprintf(out, "%s load: requested C %.3f us, %.3f ns/eval, subInterval %d",
+			name, (double)lc->target_ns / 1000, lc->nsPerEval, lc->subInterval);
+	else
+		fprintf(out, "%s load: fixed, subInterval %d", name, lc->subInterval);
+
+	if(lc->jobs == 0) {
+		fprintf(out, ", no jobs\n");
+		return;
+	}
+	fprintf(out, ", achieved C (us) min: %.3f mean: %.3f max: %.3f over %llu jobs",
+		(double)lc->min_ns / 1000, (double)lc->sum_ns / lc->jobs / 1000,
+		(double)lc->max_ns / 1000, (unsigned long long)lc->jobs);
+	if(lc->target_ns)
+		fprintf(out, " (%+.2f%%, %llu recalibrations)",
+			100.0 * ((double)lc->min_ns - lc->target_ns) / lc->target_ns,
+			(unsigned long long)lc->recalibrations);
+	fprintf(out, "\n");
+}
@@ -0,0 +1,54 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Self-calibrating synthetic load (Heavy_Work)
+ *
+ * Instead of a hard-coded "subInterval", the load is specified by
+ * the execution time it must take (C). LoadCal_Init() measures the
+ * cost of the selected integration kernel against CLOCK_MONOTONIC
+ * and derives the number of sub-intervals that takes C. Each job
+ * is timed; the fastest job of every LOADCAL_WINDOW jobs (the one
+ * least disturbed by preemptions) is compared with C and, when it
+ * drifts more than LOADCAL_DRIFT_PCT %, the iteration count is
+ * rescaled (e.g. after a frequency change).
+ *
+ * With a target of 0 the load is not calibrated and the given
+ * default sub-interval count is used, as in the original code.
+ *
+ * LoadCal_InitKernel() calibrates for another kernel with the
+ * signature of Integ_Kernel (e.g. ForkJoin_Kernel, see forkJoin.h).
+ *
+ *****************************************************************/
+
+#ifndef LOAD_CAL_H
+#define LOAD_CAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "integKernel.h"
+
+#define LOADCAL_LOWER 0			// Integration range of Heavy_Work
+#define LOADCAL_UPPER 100
+#define LOADCAL_MIN_SUBINTERVAL 16	// Smallest load that can be generated
+#define LOADCAL_WINDOW 32		// Jobs between drift checks
+#define LOADCAL_DRIFT_PCT 5		// Tolerated deviation of the fastest job from C
+
+struct loadCal {
+	integKernelFn kernel;		// Kernel that generates the load
+	uint64_t target_ns;		// Requested execution time (0: fixed load)
+	int subInterval;		// Current iteration count
+	double nsPerEval;		// Calibrated cost of one evaluation of f()
+	uint64_t jobs;			// Jobs executed
+	uint64_t recalibrations;	// Drift corrections
+	uint64_t min_ns, max_ns, sum_ns;	// Achieved execution time
+	uint64_t winMin_ns;		// Fastest job of the current window
+	double value;			// Last integration result
+};
+
+int LoadCal_Init(struct loadCal *lc, uint64_t target_ns, int defaultSubInterval);
+int LoadCal_InitKernel(struct loadCal *lc, integKernelFn kernel, uint64_t target_ns, int defaultSubInterval);
+double LoadCal_Run(struct loadCal *lc);
+void LoadCal_Print(const struct loadCal *lc, const char *name, FILE *out);
+
+#endif
@@ -0,0 +1,66 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Overrun handling policies - implementation
+ *
+ *****************************************************************/
+
+#include <string.h>
+#include <errno.h>
+
+#include "overrun.h"
+
+static const char *names[] = { "catchup", "skip", "abort" };
+
+/* Returns the policy with the given name, or -EINVAL */
+int Overrun_Parse(const char *name)
+{
+	int i;
+
+	for(i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+		if(!strcmp(name, names[i]))
+			return i;
+	return -EINVAL;
+}
+
+const char *Overrun_Name(enum overrunPolicy policy)
+{
+	return names[policy];
+}
+
+void Overrun_Init(struct overrunCtl *o, enum overrunPolicy policy, uint64_t period_ns, uint64_t deadline_ns)
+{
+	memset(o, 0, sizeof(*o));
+	o->policy = policy;
+	o->period_ns = period_ns;
+	o->deadline_ns = deadline_ns;
+}
+
+/* Called at each wakeup (RT side), with the number of releases that
+ * passed while the task was late and how late it is for the release
+ * it will serve (ns). Returns 1 if the job must be executed, 0 if it
+ * is aborted: the lateness that counts is that of the oldest pending
+ * release, before the missed ones are skipped */
+int Overrun_Check(struct overrunCtl *o, uint64_t missed, uint64_t late_ns)
+{
+	if(missed) {
+		o->overruns++;
+		o->missed += missed;
+		if(o->policy == OVERRUN_CATCHUP)
+			o->caughtUp += missed;
+		else
+			o->skipped += missed;
+	}
+	if(o->policy == OVERRUN_ABORT && late_ns + missed * o->period_ns > o->deadline_ns) {
+		o->aborted++;
+		return 0;
+	}
+	return 1;
+}
+
+void Overrun_Print(const struct overrunCtl *o, const char *name, FILE *out)
+{
+	fprintf(out, "%s overrun policy %s: %llu overruns, %llu releases missed (%llu caught up, %llu skipped), %llu jobs aborted\n",
+		name, Overrun_Name(o->policy), (unsigned long long)o->overruns, (unsigned long long)o->missed,
+		(unsigned long long)o->caughtUp, (unsigned long long)o->skipped, (unsigned long long)o->aborted);
+}
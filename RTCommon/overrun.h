@@ -0,0 +1,54 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Overrun handling policies for periodic tasks
+ *
+ * A job overruns when its task only wakes up after one or more of
+ * the following releases have passed (e.g. the previous job took
+ * longer than the period). Policies:
+ *	- catch-up: every release is served, the late ones back-to-back
+ *	  (what a plain clock_nanosleep loop on ts += T does)
+ *	- skip: the missed releases are dropped and counted, the task
+ *	  continues from the latest one (like rt_task_wait_period)
+ *	- abort: as skip, and in addition the job is not executed when
+ *	  the task wakes up after the absolute deadline of the oldest
+ *	  release still pending. That is the first missed release, so
+ *	  its lateness is missed * T plus the lateness for the latest
+ *	  release (with D <= T, any missed release aborts the job)
+ *
+ * Overrun_Check() is called once per wakeup, with the number of
+ * releases missed and the lateness for the release the task will
+ * serve; the caller adjusts its own timeline.
+ *
+ *****************************************************************/
+
+#ifndef OVERRUN_H
+#define OVERRUN_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum overrunPolicy {
+	OVERRUN_CATCHUP,
+	OVERRUN_SKIP,
+	OVERRUN_ABORT
+};
+
+struct overrunCtl {
+	enum overrunPolicy policy;
+	uint64_t period_ns;
+	uint64_t deadline_ns;		// Relative deadline (abort policy)
+	uint64_t overruns;		// Late wakeups (one or more releases missed)
+	uint64_t missed;		// Releases missed in total
+	uint64_t caughtUp;		// Missed releases served late (catch-up)
+	uint64_t skipped;		// Missed releases dropped (skip, abort)
+	uint64_t aborted;		// Jobs not executed (abort)
+};
+
+int Overrun_Parse(const char *name);
+const char *Overrun_Name(enum overrunPolicy policy);
+void Overrun_Init(struct overrunCtl *o, enum overrunPolicy policy, uint64_t period_ns, uint64_t deadline_ns);
+int Overrun_Check(struct overrunCtl *o, uint64_t missed, uint64_t late_ns);
+void Overrun_Print(const struct overrunCtl *o, const char *name, FILE *out);
+
+#endif
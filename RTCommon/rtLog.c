@@ -0,0 +1,290 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Deferred logging for RT tasks - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "rtLog.h"
+
+/* Argument classes, derived from the printf conversion */
+#define ARG_NONE 0
+#define ARG_INT 1
+#define ARG_UINT 2
+#define ARG_DOUBLE 3
+#define ARG_STR 4
+#define ARG_PTR 5
+
+/* Parses the conversion spec starting at fmt (just after the '%').
+ * Returns the argument class and stores in *len the spec length and
+ * in *lenmod the length modifier: 0 (int), 'H' (hh), 'h', 'l',
+ * 'L' (ll), 'z' or 'j' */
+static int ParseSpec(const char *fmt, int *len, char *lenmod)
+{
+	const char *p = fmt;
+
+	while(*p && strchr("-+ #0", *p))
+		p++;
+	while(*p >= '0' && *p <= '9')
+		p++;
+	if(*p == '.') {
+		p++;
+		while(*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	*lenmod = 0;
+	if(p[0] == 'h' && p[1] == 'h') { *lenmod = 'H'; p += 2; }
+	else if(p[0] == 'l' && p[1] == 'l') { *lenmod = 'L'; p += 2; }
+	else if(*p && strchr("hlzjt", *p)) { *lenmod = *p; p++; }
+
+	*len = (int)(p - fmt) + (*p ? 1 : 0);
+	switch(*p) {
+		case 'd': case 'i': case 'c':
+			return ARG_INT;
+		case 'u': case 'x': case 'X': case 'o':
+			return ARG_UINT;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			return ARG_DOUBLE;
+		case 's':
+			return ARG_STR;
+		case 'p':
+			return ARG_PTR;
+		default: // '%%' or unsupported
+			return ARG_NONE;
+	}
+}
+
+void RtLog_Init(struct rtLog *log, const char *name)
+{
+	log->name = name;
+	atomic_store(&log->head, 0);
+	atomic_store(&log->tail, 0);
+	atomic_store(&log->dropped, 0);
+}
+
+/* RT side. Stores the record in the ring, or counts it as dropped if
+ * the ring is full. Returns 0 on success, -ENOSPC if dropped */
+int RtLog_Printf(struct rtLog *log, const char *fmt, ...)
+{
+	uint32_t head, tail;
+	struct rtLogRecord *r;
+	const char *p;
+	va_list ap;
+	int narg = 0, nstr = 0, len, cls;
+	char lenmod;
+
+	head = atomic_load_explicit(&log->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&log->tail, memory_order_acquire);
+	if(head - tail >= RTLOG_RING_LEN) {
+		atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+		return -ENOSPC;
+	}
+
+	r = &log->ring[head & (RTLOG_RING_LEN - 1)];
+	r->fmt = fmt;
+
+	va_start(ap, fmt);
+	for(p = fmt; *p && narg < RTLOG_MAX_ARGS; p++) {
+		if(*p != '%')
+			continue;
+		cls = ParseSpec(p + 1, &len, &lenmod);
+		p += len;
+		switch(cls) {
+			case ARG_INT:
+				if(lenmod == 'l') r->args[narg].i = va_arg(ap, long);
+				else if(lenmod == 'L') r->args[narg].i = va_arg(ap, long long);
+				else if(lenmod == 'z' || lenmod == 'j' || lenmod == 't') r->args[narg].i = va_arg(ap, ssize_t);
+				else r->args[narg].i = va_arg(ap, int);
+				narg++;
+				break;
+			case ARG_UINT:
+				if(lenmod == 'l') r->args[narg].u = va_arg(ap, unsigned long);
+				else if(lenmod == 'L') r->args[narg].u = va_arg(ap, unsigned long long);
+				else if(lenmod == 'z' || lenmod == 'j' || lenmod == 't') r->args[narg].u = va_arg(ap, size_t);
+				else r->args[narg].u = va_arg(ap, unsigned int);
+				narg++;
+				break;
+			case ARG_DOUBLE:
+				r->args[narg++].d = va_arg(ap, double);
+				break;
+			case ARG_STR:
+				if(nstr < RTLOG_MAX_STR) {
+					const char *s = va_arg(ap, const char *);
+					strncpy(r->str[nstr], s ? s : "(null)", RTLOG_STR_LEN - 1);
+					r->str[nstr][RTLOG_STR_LEN - 1] = '\0';
+					r->args[narg++].i = nstr++;
+				} else {
+					r->args[narg++].i = -1; // No room left to copy the string
+					(void)va_arg(ap, const char *);
+				}
+				break;
+			case ARG_PTR:
+				r->args[narg++].p = va_arg(ap, void *);
+				break;
+		}
+	}
+	va_end(ap);
+
+	atomic_store_explicit(&log->head, head + 1, memory_order_release);
+	return 0;
+}
+
+/* Logger side. Formats one record, one conversion at a time, with the
+ * argument types recorded by the producer */
+static void FormatRecord(const struct rtLogRecord *r, FILE *out)
+{
+	const char *p;
+	char spec[32], lenmod;
+	int narg = 0, len, cls, n;
+
+	for(p = r->fmt; *p; p++) {
+		if(*p != '%') {
+			fputc(*p, out);
+			continue;
+		}
+		cls = ParseSpec(p + 1, &len, &lenmod);
+		if(cls == ARG_NONE || narg >= RTLOG_MAX_ARGS || len >= (int)sizeof(spec) - 3) {
+			if(p[len] == '%')
+				fputc('%', out);
+			else
+				fwrite(p, 1, len + 1, out); // Unsupported conversions are kept verbatim
+			p += len;
+			continue;
+		}
+
+		/* Rebuild the spec without the length modifier */
+		n = 0;
+		spec[n++] = '%';
+		for(int i = 0; i < len - 1; i++)
+			if(!strchr("hlzjt", p[1 + i]))
+				spec[n++] = p[1 + i];
+		if(cls == ARG_INT || cls == ARG_UINT) {
+			if(p[len] != 'c') {
+				spec[n++] = 'l';
+				spec[n++] = 'l';
+			}
+		}
+		spec[n++] = p[len];
+		spec[n] = '\0';
+
+		switch(cls) {
+			case ARG_INT:
+				if(p[len] == 'c')
+					fprintf(out, spec, (int)r->args[narg].i);
+				else
+					fprintf(out, spec, r->args[narg].i);
+				break;
+			case ARG_UINT:
+				fprintf(out, spec, r->args[narg].u);
+				break;
+			case ARG_DOUBLE:
+				fprintf(out, spec, r->args[narg].d);
+				break;
+			case ARG_STR:
+				fprintf(out, spec, r->args[narg].i < 0 ? "(...)" : r->str[r->args[narg].i]);
+				break;
+			case ARG_PTR:
+				fprintf(out, spec, r->args[narg].p);
+				break;
+		}
+		narg++;
+		p += len;
+	}
+}
+
+/* Formats all pending records of a ring. Returns the number of records */
+int RtLog_Drain(struct rtLog *log, FILE *out)
+{
+	uint32_t head, tail;
+	int n = 0;
+
+	tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+	head = atomic_load_explicit(&log->head, memory_order_acquire);
+	while(tail != head) {
+		FormatRecord(&log->ring[tail & (RTLOG_RING_LEN - 1)], out);
+		tail++;
+		n++;
+		atomic_store_explicit(&log->tail, tail, memory_order_release);
+	}
+	return n;
+}
+
+/* *************************
+* Logger thread
+* **************************/
+
+static struct {
+	struct rtLog *logs[RTLOG_MAX_RINGS];
+	int nlogs;
+	FILE *out;
+	pthread_t thread;
+	volatile int stop;
+} logger;
+
+static void *Logger_code(void *arg)
+{
+	struct timespec tdrain = { 0, RTLOG_DRAIN_PERIOD_MS * 1000L * 1000L };
+	int i, n;
+
+	(void)arg;
+
+	while(!logger.stop) {
+		for(i = 0, n = 0; i < logger.nlogs; i++)
+			n += RtLog_Drain(logger.logs[i], logger.out);
+		if(n)
+			fflush(logger.out);
+		else
+			nanosleep(&tdrain, NULL);
+	}
+	return NULL;
+}
+
+/* Starts the logger thread, with the default (non RT) scheduling
+ * policy, serving the given rings */
+int RtLogger_Start(struct rtLog **logs, int nlogs, FILE *out)
+{
+	pthread_attr_t attr;
+	int err;
+
+	if(nlogs > RTLOG_MAX_RINGS)
+		return -EINVAL;
+
+	memcpy(logger.logs, logs, nlogs * sizeof(logs[0]));
+	logger.nlogs = nlogs;
+	logger.out = out;
+	logger.stop = 0;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	err = pthread_create(&logger.thread, &attr, Logger_code, NULL);
+	pthread_attr_destroy(&attr);
+	return -err;
+}
+
+/* Stops the logger thread, flushes what is left and reports the
+ * number of dropped records of each ring */
+void RtLogger_Stop(void)
+{
+	int i;
+	uint64_t dropped;
+
+	logger.stop = 1;
+	pthread_join(logger.thread, NULL);
+
+	for(i = 0; i < logger.nlogs; i++) {
+		RtLog_Drain(logger.logs[i], logger.out);
+		dropped = atomic_load(&logger.logs[i]->dropped);
+		if(dropped)
+			fprintf(logger.out, "Log %s: %llu records dropped (ring full)\n",
+				logger.logs[i]->name, (unsigned long long)dropped);
+	}
+	fflush(logger.out);
+}
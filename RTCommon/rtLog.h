@@ -0,0 +1,66 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Deferred logging for RT tasks
+ *
+ * Each RT task owns a single-producer/single-consumer ring of
+ * fixed-size binary records. RtLog_Printf() only stores the format
+ * pointer and the raw arguments in the ring: it never allocates,
+ * locks or makes a syscall, so it can replace printf() inside the
+ * periodic loop. A low priority logger thread drains the rings and
+ * does the actual formatting and output.
+ *
+ * Known issues and limitations:
+ *		- The format must be a string literal (only its address is kept)
+ *		- At most RTLOG_MAX_ARGS arguments; "*" width/precision and
+ *		  long double are not supported
+ *		- Strings are copied, truncated to RTLOG_STR_LEN-1 characters,
+ *		  at most RTLOG_MAX_STR of them per record
+ *		- When a ring is full the record is discarded and counted
+ *
+ *****************************************************************/
+
+#ifndef RT_LOG_H
+#define RT_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define RTLOG_RING_LEN 1024		// Records per ring (must be a power of 2)
+#define RTLOG_MAX_ARGS 6		// Arguments per record
+#define RTLOG_MAX_STR 2			// String arguments per record
+#define RTLOG_STR_LEN 32		// Storage for each string argument
+#define RTLOG_MAX_RINGS 8		// Rings served by the logger thread
+#define RTLOG_DRAIN_PERIOD_MS 10	// Logger thread polling period
+
+union rtLogArg {
+	long long i;
+	unsigned long long u;
+	double d;
+	const void *p;
+};
+
+struct rtLogRecord {
+	const char *fmt;
+	union rtLogArg args[RTLOG_MAX_ARGS];
+	char str[RTLOG_MAX_STR][RTLOG_STR_LEN];
+};
+
+struct rtLog {
+	const char *name;
+	_Alignas(64) _Atomic uint32_t head;	// Next slot to write (producer)
+	_Atomic uint64_t dropped;		// Records lost because the ring was full
+	_Alignas(64) _Atomic uint32_t tail;	// Next slot to read (consumer)
+	struct rtLogRecord ring[RTLOG_RING_LEN];
+};
+
+void RtLog_Init(struct rtLog *log, const char *name);
+int RtLog_Printf(struct rtLog *log, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int RtLog_Drain(struct rtLog *log, FILE *out);
+
+int RtLogger_Start(struct rtLog **logs, int nlogs, FILE *out);
+void RtLogger_Stop(void);
+
+#endif
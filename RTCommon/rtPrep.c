@@ -0,0 +1,105 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Preparation of a process for RT execution - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "rtPrep.h"
+
+static int dmaFd = -1;	// Kept open while the latency request must hold
+
+/* Locks the process memory and prefaults heapReserve bytes of heap.
+ * Returns 0 or -errno (of mlockall) */
+int RtPrep_Process(size_t heapReserve)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	char *p;
+	size_t i;
+	int err = 0;
+
+	mallopt(M_MMAP_MAX, 0);			// Every allocation from the (locked) heap
+	mallopt(M_TRIM_THRESHOLD, -1);	// Freed memory stays in the process
+
+	if(mlockall(MCL_CURRENT | MCL_FUTURE))
+		err = -errno;
+
+	if(heapReserve) {
+		p = malloc(heapReserve);
+		if(p != NULL) {
+			for(i = 0; i < heapReserve; i += page)
+				p[i] = 0;
+			free(p);
+		}
+	}
+	return err;
+}
+
+/* Touches "size" bytes of the stack of the calling thread (call at
+ * the start of the thread, before the periodic loop) */
+void RtPrep_Stack(size_t size)
+{
+	volatile char *stack = alloca(size);
+	long page = sysconf(_SC_PAGESIZE);
+	size_t i;
+
+	for(i = 0; i < size; i += page)
+		stack[i] = 0;
+}
+
+/* Requests a maximum wakeup latency of the CPUs (PM QoS). The request
+ * holds until RtPrep_Release(). Returns 0 or -errno */
+int RtPrep_DmaLatency(int32_t latency_us)
+{
+	int err;
+
+	if(dmaFd >= 0)
+		close(dmaFd);
+	dmaFd = open("/dev/cpu_dma_latency", O_WRONLY);
+	if(dmaFd < 0)
+		return -errno;
+	if(write(dmaFd, &latency_us, sizeof(latency_us)) != sizeof(latency_us)) {
+		err = -errno;
+		close(dmaFd);
+		dmaFd = -1;
+		return err;
+	}
+	return 0;
+}
+
+void RtPrep_Release(void)
+{
+	if(dmaFd >= 0)
+		close(dmaFd);
+	dmaFd = -1;
+}
+
+/* Page faults of the calling thread */
+void RtPrep_Faults(struct rtFaults *f)
+{
+	struct rusage ru;
+
+	if(getrusage(RUSAGE_THREAD, &ru)) {
+		f->minor = f->major = -1;
+		return;
+	}
+	f->minor = ru.ru_minflt;
+	f->major = ru.ru_majflt;
+}
+
+void RtPrep_PrintFaults(const struct rtFaults *from, const struct rtFaults *to,
+						const char *what, FILE *out)
+{
+	fprintf(out, "%s: %ld minor / %ld major page faults\n",
+		what, to->minor - from->minor, to->major - from->major);
+}
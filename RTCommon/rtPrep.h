@@ -0,0 +1,45 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Preparation of a process for RT execution
+ *
+ * Removes the sources of the initial transient of a periodic task:
+ *	- RtPrep_Process(): locks all current and future memory, stops
+ *	  malloc from giving memory back to the kernel or using mmap,
+ *	  and prefaults a heap reserve, so later allocations up to that
+ *	  size do not page-fault
+ *	- RtPrep_Stack(): prefaults the stack of the calling thread
+ *	- RtPrep_DmaLatency(): holds /dev/cpu_dma_latency at the given
+ *	  value (0: no deep C-states) while the file is open
+ *	- RtPrep_Faults(): page faults of the calling thread so far, to
+ *	  check that there are none in steady state
+ *
+ * Every step is best effort: failures (e.g. no privileges) are
+ * returned as -errno and the application may go on.
+ *
+ *****************************************************************/
+
+#ifndef RT_PREP_H
+#define RT_PREP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define RTPREP_HEAP_RESERVE (8*1024*1024)	// Default prefaulted heap
+#define RTPREP_STACK_PREFAULT (256*1024)	// Default prefaulted stack
+
+struct rtFaults {
+	long minor;		// Page faults served without I/O
+	long major;		// Page faults that needed I/O
+};
+
+int RtPrep_Process(size_t heapReserve);
+void RtPrep_Stack(size_t size);
+int RtPrep_DmaLatency(int32_t latency_us);
+void RtPrep_Release(void);
+void RtPrep_Faults(struct rtFaults *f);
+void RtPrep_PrintFaults(const struct rtFaults *from, const struct rtFaults *to,
+						const char *what, FILE *out);
+
+#endif
@@ -0,0 +1,468 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Compact binary log of sensor samples - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sampleLog.h"
+
+_Static_assert(sizeof(struct sampleLogHeader) == 32, "log header must be 32 bytes");
+_Static_assert(sizeof(struct sampleLogBlock) == 56, "block header must be 56 bytes");
+_Static_assert(sizeof(struct sampleLogIndexEntry) == 24, "index entry must be 24 bytes");
+_Static_assert(sizeof(struct sampleLogFooter) == 32, "log footer must be 32 bytes");
+
+/* The payloads are padded to 8 bytes, so that every header in the
+ * file is aligned (the reader uses them in place) */
+#define PAD8(n) (((n) + 7) & ~(size_t)7)
+#define BLOCK_BYTES(samples) PAD8(sizeof(struct sampleLogBlock) + (samples) * SAMPLE_LOG_MAX_SAMPLE_BYTES)
+
+/* CRC-32 (IEEE 802.3, as zlib), four bits at a time: a 16 entry table
+ * needs no initialisation. Start with crc = 0 */
+uint32_t SampleLog_Crc32(uint32_t crc, const void *data, size_t len)
+{
+	static const uint32_t tab[16] = {
+		0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+		0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+	};
+	const uint8_t *p = data;
+
+	crc = ~crc;
+	while(len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ tab[crc & 15];
+		crc = (crc >> 4) ^ tab[crc & 15];
+	}
+	return ~crc;
+}
+
+static uint32_t BlockCrc(const struct sampleLogBlock *b)
+{
+	struct sampleLogBlock h = *b;
+
+	h.crc = 0;
+	return SampleLog_Crc32(SampleLog_Crc32(0, &h, sizeof(h)), b + 1, b->payloadLen);
+}
+
+/* ******************
+ * Varints
+ * ******************/
+
+static uint64_t ZigZag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t UnZigZag(uint64_t u)
+{
+	return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+/* LEB128: 7 bits per byte, low first, top bit set on all but the last */
+static size_t PutVarint(uint8_t *p, uint64_t v)
+{
+	size_t n = 0;
+
+	while(v >= 0x80) {
+		p[n++] = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	p[n++] = (uint8_t)v;
+	return n;
+}
+
+/* Returns the bytes used, or 0 if the varint is truncated or too long */
+static size_t GetVarint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+	size_t n;
+
+	*v = 0;
+	for(n = 0; p + n < end && n < 10; n++) {
+		*v |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+		if(!(p[n] & 0x80))
+			return n + 1;
+	}
+	return 0;
+}
+
+/* ******************
+ * Writer
+ * ******************/
+
+/* Sets up the encoder, with the file header already in the output.
+ * blockSamples 0 is SAMPLE_LOG_DEFAULT_BLOCK. Returns 0 or -errno */
+int SampleLog_Open(struct sampleLog *l, uint32_t blockSamples)
+{
+	struct sampleLogHeader *h;
+
+	memset(l, 0, sizeof(*l));
+	if(blockSamples == 0)
+		blockSamples = SAMPLE_LOG_DEFAULT_BLOCK;
+	if(blockSamples > SAMPLE_LOG_MAX_BLOCK)
+		return -EINVAL;
+	l->blockSamples = blockSamples;
+
+	/* Room for the header and two blocks to start with: the caller
+	 * takes the output after each batch, and FinishBlock() grows it if
+	 * a batch spans more blocks */
+	l->outSize = sizeof(*h) + 2 * BLOCK_BYTES(blockSamples);
+	l->indexSize = 1024;
+	l->blk = calloc(1, BLOCK_BYTES(blockSamples));
+	l->out = malloc(l->outSize);
+	l->index = malloc(l->indexSize * sizeof(*l->index));
+	if(l->blk == NULL || l->out == NULL || l->index == NULL) {
+		SampleLog_Close(l);
+		return -ENOMEM;
+	}
+	l->cur = (struct sampleLogBlock *)l->blk;
+
+	h = (struct sampleLogHeader *)l->out;
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, SAMPLE_LOG_MAGIC, sizeof(h->magic));
+	h->version = SAMPLE_LOG_VERSION;
+	h->blockSamples = blockSamples;
+	l->outLen = sizeof(*h);
+	return 0;
+}
+
+/* Moves the block being encoded to the output (doubled when full, so
+ * it settles at the size of the largest batch). Returns 0 or -ENOMEM */
+static int FinishBlock(struct sampleLog *l)
+{
+	size_t len = sizeof(*l->cur) + l->cur->payloadLen;
+	struct sampleLogIndexEntry *idx;
+	char *out;
+
+	if(l->outLen + PAD8(len) > l->outSize) {
+		out = realloc(l->out, 2 * l->outSize);
+		if(out == NULL)
+			return -ENOMEM;
+		l->out = out;
+		l->outSize *= 2;
+	}
+	if(l->blocks == l->indexSize) {
+		idx = realloc(l->index, 2 * l->indexSize * sizeof(*idx));
+		if(idx == NULL)
+			return -ENOMEM;
+		l->index = idx;
+		l->indexSize *= 2;
+	}
+	l->index[l->blocks].offset = l->offset + l->outLen;
+	l->index[l->blocks].firstSeq = l->cur->firstSeq;
+	l->index[l->blocks].firstTs = l->cur->firstTs;
+	l->blocks++;
+
+	l->cur->magic = SAMPLE_LOG_BLOCK_MAGIC;
+	l->cur->crc = BlockCrc(l->cur);
+	memcpy(l->out + l->outLen, l->blk, len);
+	memset(l->out + l->outLen + len, 0, PAD8(len) - len);
+	l->outLen += PAD8(len);
+	l->cur->count = 0;
+	l->cur->payloadLen = 0;
+	return 0;
+}
+
+/* Encodes one sample (RT side: no allocation, except to grow the block
+ * index or the output every time they fill). A block ends when full or when the
+ * channel changes. Returns 0, or -errno if the sample was dropped */
+int SampleLog_Append(struct sampleLog *l, const struct sensorSample *s)
+{
+	struct sampleLogBlock *b = l->cur;
+	uint8_t *p;
+	uint64_t dt;
+	int err;
+
+	if(b->count && (b->count == l->blockSamples || s->channel != b->channel)) {
+		err = FinishBlock(l);
+		if(err)
+			return err;
+	}
+
+	if(b->count == 0) {
+		b->firstSeq = s->seq;
+		b->firstTs = s->timestamp;
+		b->firstValue = s->value;
+		b->channel = s->channel;
+		l->prevDt = 0;
+	} else {
+		dt = s->timestamp - l->prevTs;
+		p = (uint8_t *)(b + 1) + b->payloadLen;
+		p += PutVarint(p, ZigZag((int64_t)(s->seq - l->prevSeq - 1)));
+		p += PutVarint(p, ZigZag((int64_t)(dt - l->prevDt)));
+		p += PutVarint(p, ZigZag((int64_t)s->value - l->prevValue));
+		b->payloadLen = p - (uint8_t *)(b + 1);
+		l->prevDt = dt;
+	}
+	b->lastSeq = s->seq;
+	b->lastTs = s->timestamp;
+	b->count++;
+	l->prevSeq = s->seq;
+	l->prevTs = s->timestamp;
+	l->prevValue = s->value;
+	l->samples++;
+	return 0;
+}
+
+/* Ends the current block now (e.g. before an fsync), even if not full */
+int SampleLog_Flush(struct sampleLog *l)
+{
+	return l->cur->count ? FinishBlock(l) : 0;
+}
+
+/* Returns the finished output, *len bytes, which the caller must write
+ * (at the end of the file) before the next call to the encoder */
+const char *SampleLog_Take(struct sampleLog *l, size_t *len)
+{
+	*len = l->outLen;
+	l->offset += l->outLen;
+	l->outLen = 0;
+	return l->out;
+}
+
+/* Ends the current block and adds the index and footer to the output,
+ * to take and write as the end of the file. Returns 0 or -errno */
+int SampleLog_Finish(struct sampleLog *l)
+{
+	struct sampleLogFooter ft;
+	size_t len;
+	char *out;
+	int err;
+
+	err = SampleLog_Flush(l);
+	if(err)
+		return err;
+	len = l->blocks * sizeof(*l->index);
+	if(l->outLen + len + sizeof(ft) > l->outSize) {
+		out = realloc(l->out, l->outLen + len + sizeof(ft));
+		if(out == NULL)
+			return -ENOMEM;
+		l->out = out;
+		l->outSize = l->outLen + len + sizeof(ft);
+	}
+
+	memset(&ft, 0, sizeof(ft));
+	ft.indexOffset = l->offset + l->outLen;
+	ft.blocks = l->blocks;
+	ft.crc = SampleLog_Crc32(0, l->index, len);
+	memcpy(ft.magic, SAMPLE_LOG_INDEX_MAGIC, sizeof(ft.magic));
+	memcpy(l->out + l->outLen, l->index, len);
+	memcpy(l->out + l->outLen + len, &ft, sizeof(ft));
+	l->outLen += len + sizeof(ft);
+	return 0;
+}
+
+void SampleLog_Close(struct sampleLog *l)
+{
+	free(l->blk);
+	free(l->out);
+	free(l->index);
+	l->blk = l->out = NULL;
+	l->cur = NULL;
+	l->index = NULL;
+}
+
+/* ******************
+ * Reader
+ * ******************/
+
+/* Checks the index written by SampleLog_Finish(). Returns 1 if usable */
+static int LoadIndex(struct sampleLogFile *f)
+{
+	const struct sampleLogFooter *ft;
+	const struct sampleLogBlock *b;
+	uint64_t off;
+	size_t i, len;
+
+	if(f->size < sizeof(*f->hdr) + sizeof(*ft))
+		return 0;
+	ft = (const struct sampleLogFooter *)(f->data + f->size - sizeof(*ft));
+	if(memcmp(ft->magic, SAMPLE_LOG_INDEX_MAGIC, sizeof(ft->magic)) ||
+	   ft->blocks > f->size / sizeof(*f->index))
+		return 0;
+	len = ft->blocks * sizeof(*f->index);
+	if(ft->indexOffset < sizeof(*f->hdr) || ft->indexOffset > f->size || ft->indexOffset + len + sizeof(*ft) != f->size ||
+	   SampleLog_Crc32(0, f->data + ft->indexOffset, len) != ft->crc)
+		return 0;
+
+	f->index = malloc(len + 1);
+	if(f->index == NULL)
+		return 0;
+	memcpy(f->index, f->data + ft->indexOffset, len);
+	f->blocks = ft->blocks;
+
+	/* Every block, payload included, must lie before the index (the
+	 * CRC is computed over payloadLen bytes before anything is checked) */
+	for(i = 0; i < f->blocks; i++) {
+		off = f->index[i].offset;
+		if(off % 8 || off < sizeof(*f->hdr) || off > ft->indexOffset || ft->indexOffset - off < sizeof(*b) ||
+		   (i > 0 && off <= f->index[i - 1].offset))
+			return 0;
+		b = (const struct sampleLogBlock *)(f->data + off);
+		if(b->payloadLen > ft->indexOffset - off - sizeof(*b))
+			return 0;
+	}
+	return 1;
+}
+
+/* Rebuilds the index from the block headers, up to the first block
+ * that is truncated or corrupt. Returns 0 or -ENOMEM */
+static int ScanIndex(struct sampleLogFile *f)
+{
+	const struct sampleLogBlock *b;
+	struct sampleLogIndexEntry *idx;
+	size_t off = sizeof(*f->hdr), size = 0;
+
+	free(f->index);
+	f->index = NULL;
+	f->blocks = 0;
+	f->rebuilt = 1;
+	while(off + sizeof(*b) <= f->size) {
+		b = (const struct sampleLogBlock *)(f->data + off);
+		if(b->magic != SAMPLE_LOG_BLOCK_MAGIC || b->count == 0 || b->count > f->hdr->blockSamples ||
+		   b->payloadLen > f->size - off - sizeof(*b) || BlockCrc(b) != b->crc)
+			break;
+		if(f->blocks == size) {
+			size = size ? 2 * size : 1024;
+			idx = realloc(f->index, size * sizeof(*idx));
+			if(idx == NULL)
+				return -ENOMEM;
+			f->index = idx;
+		}
+		f->index[f->blocks].offset = off;
+		f->index[f->blocks].firstSeq = b->firstSeq;
+		f->index[f->blocks].firstTs = b->firstTs;
+		f->blocks++;
+		off += PAD8(sizeof(*b) + b->payloadLen);
+	}
+	return 0;
+}
+
+/* Maps the log and loads (or rebuilds) its index. Returns 0 or -errno
+ * (-EINVAL if it is not a sample log) */
+int SampleLog_Map(struct sampleLogFile *f, const char *path)
+{
+	struct stat st;
+	void *p;
+	int fd, err;
+
+	memset(f, 0, sizeof(*f));
+	fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return -errno;
+	if(fstat(fd, &st)) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	if((size_t)st.st_size < sizeof(struct sampleLogHeader)) {
+		close(fd);
+		return -EINVAL;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	err = p == MAP_FAILED ? -errno : 0;
+	close(fd); // The mapping keeps the file
+	if(err)
+		return err;
+
+	f->data = p;
+	f->size = st.st_size;
+	f->hdr = p;
+	if(memcmp(f->hdr->magic, SAMPLE_LOG_MAGIC, sizeof(f->hdr->magic)) || f->hdr->version != SAMPLE_LOG_VERSION ||
+	   f->hdr->blockSamples == 0 || f->hdr->blockSamples > SAMPLE_LOG_MAX_BLOCK) {
+		SampleLog_Unmap(f);
+		return -EINVAL;
+	}
+	if(!LoadIndex(f) && (err = ScanIndex(f))) {
+		SampleLog_Unmap(f);
+		return err;
+	}
+	return 0;
+}
+
+const struct sampleLogBlock *SampleLog_Block(const struct sampleLogFile *f, size_t i)
+{
+	return (const struct sampleLogBlock *)(f->data + f->index[i].offset);
+}
+
+/* Decodes block b into smp (room for "max" samples). Returns the number
+ * of samples, or -EINVAL if the block is corrupt (checksum, length) */
+int SampleLog_Decode(const struct sampleLogBlock *b, struct sensorSample *smp, uint32_t max)
+{
+	const uint8_t *p = (const uint8_t *)(b + 1), *end = p + b->payloadLen;
+	uint64_t u[3], dt = 0;
+	uint32_t i;
+	size_t n;
+	int k;
+
+	if(b->magic != SAMPLE_LOG_BLOCK_MAGIC || b->count == 0 || b->count > max || BlockCrc(b) != b->crc)
+		return -EINVAL;
+	smp[0].seq = b->firstSeq;
+	smp[0].timestamp = b->firstTs;
+	smp[0].value = b->firstValue;
+	smp[0].channel = b->channel;
+	for(i = 1; i < b->count; i++) {
+		for(k = 0; k < 3; k++) {
+			n = GetVarint(p, end, &u[k]);
+			if(n == 0)
+				return -EINVAL;
+			p += n;
+		}
+		dt += UnZigZag(u[1]);
+		smp[i].seq = smp[i - 1].seq + 1 + UnZigZag(u[0]);
+		smp[i].timestamp = smp[i - 1].timestamp + dt;
+		smp[i].value = (int32_t)(smp[i - 1].value + UnZigZag(u[2]));
+		smp[i].channel = b->channel;
+	}
+	return p == end && smp[i - 1].seq == b->lastSeq && smp[i - 1].timestamp == b->lastTs ? (int)b->count : -EINVAL;
+}
+
+/* Index of the block that holds "seq" (the last one starting at or
+ * before it; 0 if none). The sequence numbers grow along the file */
+size_t SampleLog_FindSeq(const struct sampleLogFile *f, uint64_t seq)
+{
+	size_t lo = 0, hi = f->blocks, mid;
+
+	while(hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if(f->index[mid].firstSeq <= seq)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Same, for the acquisition time "ts" */
+size_t SampleLog_FindTime(const struct sampleLogFile *f, uint64_t ts)
+{
+	size_t lo = 0, hi = f->blocks, mid;
+
+	while(hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if(f->index[mid].firstTs <= ts)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void SampleLog_Unmap(struct sampleLogFile *f)
+{
+	if(f->data != NULL)
+		munmap((void *)f->data, f->size);
+	free(f->index);
+	f->data = NULL;
+	f->hdr = NULL;
+	f->index = NULL;
+	f->blocks = 0;
+}
@@ -0,0 +1,122 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Compact binary log of sensor samples
+ *
+ * An encoder (no file I/O: the caller writes what it produces, with
+ * write() or an asyncWriter) packs samples into blocks of up to
+ * "blockSamples" samples of one channel. A block has a fixed header,
+ * with its first and last sequence number and timestamp, the first
+ * value and a CRC-32 of the whole block, followed by the other
+ * samples, each as zig-zag LEB128 varints of:
+ *	- the sequence number delta minus 1 (0 without gaps)
+ *	- the delta of the timestamp delta (small for a periodic task)
+ *	- the value delta
+ * so a sample of a periodic sensor takes a few bytes instead of 24
+ * (about 6 at 10 kHz, where most go to the timestamp jitter).
+ *
+ * The file is: header, blocks, index (offset, first sequence number
+ * and first timestamp of every block) and a footer pointing to it.
+ * The index is only written by SampleLog_Finish(): the reader
+ * rebuilds it by walking the block headers when it is missing or
+ * does not match (run not terminated cleanly), and stops at the
+ * first truncated or corrupt block.
+ *
+ * The sampleLogReader tool exports a log to CSV, optionally only a
+ * range of sequence numbers or timestamps.
+ *
+ *****************************************************************/
+
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sensorStream.h"
+
+#define SAMPLE_LOG_MAGIC "RTSLOG01"
+#define SAMPLE_LOG_INDEX_MAGIC "RTSLIDX1"
+#define SAMPLE_LOG_BLOCK_MAGIC 0x4b424c53	// "SLBK"
+#define SAMPLE_LOG_VERSION 1
+#define SAMPLE_LOG_DEFAULT_BLOCK 4096		// Samples per block
+#define SAMPLE_LOG_MAX_BLOCK 65536
+#define SAMPLE_LOG_MAX_SAMPLE_BYTES 25		// Three varints: 10 + 10 + 5
+
+/* File header (fixed 32 bytes) */
+struct sampleLogHeader {
+	char magic[8];				// SAMPLE_LOG_MAGIC
+	uint32_t version;
+	uint32_t blockSamples;			// Most samples in a block
+	uint8_t reserved[16];
+};
+
+/* Block header (fixed 56 bytes), followed by payloadLen bytes */
+struct sampleLogBlock {
+	uint32_t magic;				// SAMPLE_LOG_BLOCK_MAGIC
+	uint32_t count;				// Samples, the first one included
+	uint32_t payloadLen;
+	uint32_t crc;				// CRC-32 of header (crc = 0) and payload
+	uint64_t firstSeq, lastSeq;
+	uint64_t firstTs, lastTs;
+	int32_t firstValue;
+	uint32_t channel;
+};
+
+struct sampleLogIndexEntry {
+	uint64_t offset;			// Of the block header
+	uint64_t firstSeq;
+	uint64_t firstTs;
+};
+
+/* Footer (fixed 32 bytes), at the end of the file */
+struct sampleLogFooter {
+	uint64_t indexOffset;
+	uint64_t blocks;			// Index entries
+	uint32_t crc;				// CRC-32 of the index
+	uint32_t reserved;
+	char magic[8];				// SAMPLE_LOG_INDEX_MAGIC
+};
+
+/* Writer side */
+struct sampleLog {
+	uint32_t blockSamples;
+	char *blk;				// Block being encoded (header and payload)
+	struct sampleLogBlock *cur;		// Its header, count 0 when empty
+	uint64_t prevSeq, prevTs, prevDt;
+	int32_t prevValue;
+	char *out;				// Finished blocks, for the caller to write
+	size_t outLen, outSize;
+	uint64_t offset;			// File offset of out
+	struct sampleLogIndexEntry *index;
+	size_t blocks, indexSize;
+	uint64_t samples;			// Counters
+};
+
+int SampleLog_Open(struct sampleLog *l, uint32_t blockSamples);
+int SampleLog_Append(struct sampleLog *l, const struct sensorSample *s);
+int SampleLog_Flush(struct sampleLog *l);
+const char *SampleLog_Take(struct sampleLog *l, size_t *len);
+int SampleLog_Finish(struct sampleLog *l);
+void SampleLog_Close(struct sampleLog *l);
+
+/* Reader side: maps an existing log read-only */
+struct sampleLogFile {
+	const char *data;
+	size_t size;
+	const struct sampleLogHeader *hdr;
+	struct sampleLogIndexEntry *index;
+	size_t blocks;
+	int rebuilt;				// Index rebuilt by scanning the blocks
+};
+
+int SampleLog_Map(struct sampleLogFile *f, const char *path);
+const struct sampleLogBlock *SampleLog_Block(const struct sampleLogFile *f, size_t i);
+int SampleLog_Decode(const struct sampleLogBlock *b, struct sensorSample *smp, uint32_t max);
+size_t SampleLog_FindSeq(const struct sampleLogFile *f, uint64_t seq);
+size_t SampleLog_FindTime(const struct sampleLogFile *f, uint64_t ts);
+void SampleLog_Unmap(struct sampleLogFile *f);
+
+uint32_t SampleLog_Crc32(uint32_t crc, const void *data, size_t len);
+
+#endif
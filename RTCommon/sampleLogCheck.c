@@ -0,0 +1,189 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Round trip check of the binary sample log (see sampleLog.h)
+ *
+ * Usage: sampleLogCheck [TMPFILE]
+ *		Encodes a batch of samples many blocks long without taking
+ *		the output in between, writes the log to TMPFILE (default
+ *		/tmp/sampleLogCheck.bin), maps it back and compares every
+ *		sample. Then corrupts the payload length of the last block,
+ *		with the index left valid, and checks that the index is
+ *		rejected and rebuilt up to that block. Prints "OK" and returns
+ *		0, or the first mismatch and returns 1. Run by "make check".
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sampleLog.h"
+
+#define BLOCK_SAMPLES 4		// Small blocks...
+#define BATCH 1000			// ... and a batch of many of them
+
+static struct sensorSample in[BATCH], smp[BLOCK_SAMPLES];
+
+static int WriteAll(int fd, const char *data, size_t len)
+{
+	ssize_t n;
+
+	while(len) {
+		n = write(fd, data, len);
+		if(n <= 0)
+			return -1;
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Encodes "in" as one batch and writes the whole log to path */
+static int Encode(const char *path)
+{
+	struct sampleLog l;
+	const char *data;
+	size_t len;
+	int fd, i, err;
+
+	err = SampleLog_Open(&l, BLOCK_SAMPLES);
+	if(err) {
+		printf("SampleLog_Open: error %d\n", err);
+		return -1;
+	}
+	for(i = 0; i < BATCH; i++) {
+		err = SampleLog_Append(&l, &in[i]);
+		if(err) {
+			printf("SampleLog_Append: sample %d dropped (error %d)\n", i, err);
+			SampleLog_Close(&l);
+			return -1;
+		}
+	}
+	err = SampleLog_Finish(&l);
+	if(err) {
+		printf("SampleLog_Finish: error %d\n", err);
+		SampleLog_Close(&l);
+		return -1;
+	}
+	data = SampleLog_Take(&l, &len);
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0 || WriteAll(fd, data, len)) {
+		perror(path);
+		if(fd >= 0)
+			close(fd);
+		SampleLog_Close(&l);
+		return -1;
+	}
+	close(fd);
+	SampleLog_Close(&l);
+	return 0;
+}
+
+/* Maps the log back and compares it with "in" */
+static int Verify(const char *path)
+{
+	struct sampleLogFile f;
+	size_t b;
+	int n, k, i = 0, err;
+
+	err = SampleLog_Map(&f, path);
+	if(err) {
+		printf("SampleLog_Map: error %d\n", err);
+		return -1;
+	}
+	if(f.rebuilt) {
+		printf("Index not loaded from the file\n");
+		SampleLog_Unmap(&f);
+		return -1;
+	}
+	for(b = 0; b < f.blocks; b++) {
+		n = SampleLog_Decode(SampleLog_Block(&f, b), smp, BLOCK_SAMPLES);
+		if(n < 0) {
+			printf("Block %zu corrupt\n", b);
+			SampleLog_Unmap(&f);
+			return -1;
+		}
+		for(k = 0; k < n; k++, i++)
+			if(i >= BATCH || smp[k].seq != in[i].seq || smp[k].timestamp != in[i].timestamp ||
+			   smp[k].value != in[i].value || smp[k].channel != in[i].channel) {
+				printf("Sample %d (block %zu) differs\n", i, b);
+				SampleLog_Unmap(&f);
+				return -1;
+			}
+	}
+	SampleLog_Unmap(&f);
+	if(i != BATCH) {
+		printf("%d samples read back, %d written\n", i, BATCH);
+		return -1;
+	}
+	return 0;
+}
+
+/* Sets a payload length reaching past the end of the file in the last
+ * block: the reader must not trust the index (and read out of the
+ * mapping), but rebuild it up to that block */
+static int CorruptLast(const char *path)
+{
+	struct sampleLogFile f;
+	uint32_t len = UINT32_MAX - 64;
+	uint64_t off;
+	size_t blocks;
+	int fd, err;
+
+	err = SampleLog_Map(&f, path);
+	if(err) {
+		printf("SampleLog_Map: error %d\n", err);
+		return -1;
+	}
+	blocks = f.blocks;
+	off = f.index[blocks - 1].offset;
+	SampleLog_Unmap(&f);
+
+	fd = open(path, O_WRONLY);
+	if(fd < 0 || pwrite(fd, &len, sizeof(len), off + offsetof(struct sampleLogBlock, payloadLen)) != sizeof(len)) {
+		perror(path);
+		if(fd >= 0)
+			close(fd);
+		return -1;
+	}
+	close(fd);
+
+	err = SampleLog_Map(&f, path);
+	if(err) {
+		printf("SampleLog_Map (corrupt block): error %d\n", err);
+		return -1;
+	}
+	if(!f.rebuilt || f.blocks != blocks - 1) {
+		printf("Corrupt block: index %s with %zu blocks, expected rebuilt with %zu\n",
+			f.rebuilt ? "rebuilt" : "loaded", f.blocks, blocks - 1);
+		SampleLog_Unmap(&f);
+		return -1;
+	}
+	SampleLog_Unmap(&f);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : "/tmp/sampleLogCheck.bin";
+	int i;
+
+	/* A periodic sensor with jitter, a sequence gap and a channel switch */
+	for(i = 0; i < BATCH; i++) {
+		in[i].seq = i < BATCH / 2 ? i : i + 7;
+		in[i].timestamp = 1000000000ULL + (uint64_t)i * 100000 + (i * 37) % 101;
+		in[i].value = (i * 7919) % 2001 - 1000;
+		in[i].channel = i < 3 * BATCH / 4 ? 0 : 1;
+	}
+	if(Encode(path) || Verify(path) || CorruptLast(path))
+		return 1;
+	unlink(path);
+	printf("OK: %d samples in blocks of %d\n", BATCH, BLOCK_SAMPLES);
+	return 0;
+}
@@ -0,0 +1,173 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Reader/converter of binary sample logs (see sampleLog.h)
+ *
+ * Usage: sampleLogReader [-c CSVFILE] [-s FIRST:LAST] [-t FROM:TO] LOGFILE...
+ *		Prints, for each log, the samples, blocks, size per sample,
+ *		sequence gaps and corrupt blocks. With -c, also exports the
+ *		samples to CSVFILE ("-" for stdout, in which case the summary
+ *		goes to stderr). -s and -t select a range (inclusive) of
+ *		sequence numbers or of timestamps (ns): either bound may be
+ *		left out. The first block of the range is found through the
+ *		block index, so only the blocks in the range are decoded.
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "sampleLog.h"
+
+struct range {
+	int set;
+	uint64_t from, to;
+};
+
+struct range seq_range, time_range;
+
+/* Parses "FROM:TO", "FROM:", ":TO" or "N". Returns 0, or -1 if invalid */
+static int ParseRange(const char *arg, struct range *r)
+{
+	const char *colon = strchr(arg, ':');
+	char *end;
+
+	r->set = 1;
+	r->from = 0;
+	r->to = UINT64_MAX;
+	if(colon != arg) {
+		r->from = strtoull(arg, &end, 10);
+		if(end != (colon != NULL ? colon : arg + strlen(arg)))
+			return -1;
+	}
+	if(colon == NULL)
+		r->to = r->from;
+	else if(colon[1] != '\0') {
+		r->to = strtoull(colon + 1, &end, 10);
+		if(*end != '\0')
+			return -1;
+	}
+	return r->from <= r->to ? 0 : -1;
+}
+
+static int ProcessLog(const char *path, FILE *csv, FILE *out)
+{
+	struct sampleLogFile f;
+	const struct sampleLogBlock *b;
+	struct sensorSample *smp;
+	uint64_t samples = 0, gaps = 0, missing = 0, bytes = 0, inBlocks = 0, prevSeq = 0;
+	uint64_t firstTs = 0, lastTs = 0;
+	size_t i, first = 0, decoded = 0, corrupt = 0;
+	int n, k, done = 0, err;
+
+	err = SampleLog_Map(&f, path);
+	if(err) {
+		fprintf(stderr, "%s: not a valid sample log (%s)\n", path, strerror(-err));
+		return -1;
+	}
+	smp = malloc(f.hdr->blockSamples * sizeof(*smp));
+	if(smp == NULL) {
+		SampleLog_Unmap(&f);
+		return -1;
+	}
+
+	/* Seek to the first block that may hold the range */
+	if(seq_range.set)
+		first = SampleLog_FindSeq(&f, seq_range.from);
+	if(time_range.set && SampleLog_FindTime(&f, time_range.from) > first)
+		first = SampleLog_FindTime(&f, time_range.from);
+
+	for(i = first; i < f.blocks && !done; i++) {
+		b = SampleLog_Block(&f, i);
+		n = SampleLog_Decode(b, smp, f.hdr->blockSamples);
+		if(n < 0) {
+			corrupt++;
+			continue;
+		}
+		decoded++;
+		bytes += sizeof(*b) + b->payloadLen;
+		inBlocks += n;
+		for(k = 0; k < n; k++) {
+			if((seq_range.set && smp[k].seq > seq_range.to) || (time_range.set && smp[k].timestamp > time_range.to)) {
+				done = 1;
+				break;
+			}
+			if((seq_range.set && smp[k].seq < seq_range.from) || (time_range.set && smp[k].timestamp < time_range.from))
+				continue;
+
+			if(samples == 0)
+				firstTs = smp[k].timestamp;
+			else if(smp[k].seq != prevSeq + 1) {
+				gaps++;
+				missing += smp[k].seq > prevSeq ? smp[k].seq - prevSeq - 1 : 0;
+			}
+			prevSeq = smp[k].seq;
+			lastTs = smp[k].timestamp;
+			samples++;
+			if(csv != NULL)
+				fprintf(csv, "%llu,%llu,%u,%d\n", (unsigned long long)smp[k].seq,
+					(unsigned long long)smp[k].timestamp, smp[k].channel, smp[k].value);
+		}
+	}
+
+	fprintf(out, "Log %s: %zu blocks of up to %u samples (index %s), %zu bytes\n", path, f.blocks,
+		f.hdr->blockSamples, f.rebuilt ? "rebuilt from the blocks" : "from the file", f.size);
+	fprintf(out, "  %s%llu samples, time span %.6f s (%zu blocks decoded, %.2f bytes/sample)\n",
+		seq_range.set || time_range.set ? "Range: " : "", (unsigned long long)samples,
+		(double)(lastTs - firstTs) / 1e9, decoded, inBlocks ? (double)bytes / inBlocks : 0.0);
+	fprintf(out, "  Sequence gaps: %llu (%llu samples missing) / Corrupt blocks: %zu\n",
+		(unsigned long long)gaps, (unsigned long long)missing, corrupt);
+
+	free(smp);
+	SampleLog_Unmap(&f);
+	return corrupt ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *csv = NULL;
+	int opt, i, err = 0;
+
+	while((opt = getopt(argc, argv, "c:s:t:")) != -1) {
+		switch(opt) {
+			case 'c':
+				csv = strcmp(optarg, "-") ? fopen(optarg, "w") : stdout;
+				if(csv == NULL) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			case 's':
+				if(ParseRange(optarg, &seq_range)) {
+					fprintf(stderr, "Invalid sequence range %s\n", optarg);
+					return 1;
+				}
+				break;
+			case 't':
+				if(ParseRange(optarg, &time_range)) {
+					fprintf(stderr, "Invalid time range %s\n", optarg);
+					return 1;
+				}
+				break;
+			default:
+				optind = argc + 1;
+				break;
+		}
+	}
+	if(optind >= argc) {
+		printf("Usage: %s [-c CSVFILE] [-s FIRST:LAST] [-t FROM_NS:TO_NS] LOGFILE...\n", argv[0]);
+		return 1;
+	}
+
+	if(csv != NULL)
+		fprintf(csv, "seq,timestamp_ns,channel,value\n");
+	for(i = optind; i < argc; i++)
+		if(ProcessLog(argv[i], csv, csv == stdout ? stderr : stdout))
+			err = 1;
+	if(csv != NULL && csv != stdout)
+		fclose(csv);
+	return err;
+}
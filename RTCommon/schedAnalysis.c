@@ -0,0 +1,217 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Schedulability analysis of periodic task sets - implementation
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+
+#include "schedAnalysis.h"
+
+#define MAX_ITER 1000000	// Fixed point iterations before giving up
+
+static uint64_t CeilDiv(uint64_t a, uint64_t b)
+{
+	return (a + b - 1) / b;
+}
+
+double SchedAnalysis_Utilization(const struct saTask *tasks, int n, int core)
+{
+	double u = 0;
+	int i;
+
+	for(i = 0; i < n; i++)
+		if(tasks[i].core == core)
+			u += (double)tasks[i].C / tasks[i].T;
+	return u;
+}
+
+/* Response time of task i, or a value above D_i if it is not schedulable */
+static uint64_t ResponseTime(const struct saTask *tasks, int n, int i)
+{
+	const struct saTask *ti = &tasks[i];
+	uint64_t w, wn, R = 0, q;
+	double u = (double)ti->C / ti->T;
+	int j, it;
+
+	for(j = 0; j < n; j++)
+		if(j != i && tasks[j].core == ti->core && tasks[j].prio >= ti->prio)
+			u += (double)tasks[j].C / tasks[j].T;
+	if(u > 1.0)
+		return SA_UNBOUNDED;
+
+	/* Level-i busy period: jobs q = 0, 1, ... of task i */
+	w = ti->C;
+	for(q = 0; ; q++) {
+		if(w < (q + 1) * ti->C)
+			w = (q + 1) * ti->C;
+		for(it = 0; it < MAX_ITER; it++) {
+			wn = (q + 1) * ti->C;
+			for(j = 0; j < n; j++)
+				if(j != i && tasks[j].core == ti->core && tasks[j].prio >= ti->prio)
+					wn += CeilDiv(w, tasks[j].T) * tasks[j].C;
+			if(wn == w || wn - q * ti->T > ti->D)
+				break;
+			w = wn;
+		}
+		if(wn - q * ti->T > R)
+			R = wn - q * ti->T;
+		if(R > ti->D || it == MAX_ITER)
+			return R > ti->D ? R : SA_UNBOUNDED;
+		if(wn <= (q + 1) * ti->T) // Busy period ends before the next job of i
+			return R;
+	}
+}
+
+/* Fixed priority response time analysis of the tasks of "core" (R of
+ * each one is updated). Returns the number of tasks with R > D */
+int SchedAnalysis_Rta(struct saTask *tasks, int n, int core)
+{
+	int i, misses = 0;
+
+	for(i = 0; i < n; i++) {
+		if(tasks[i].core != core)
+			continue;
+		tasks[i].R = ResponseTime(tasks, n, i);
+		if(tasks[i].R > tasks[i].D)
+			misses++;
+	}
+	return misses;
+}
+
+/* Processor demand of the tasks of "core" in any interval of length t */
+static uint64_t Dbf(const struct saTask *tasks, int n, int core, uint64_t t)
+{
+	uint64_t d = 0;
+	int i;
+
+	for(i = 0; i < n; i++)
+		if(tasks[i].core == core && t >= tasks[i].D)
+			d += ((t - tasks[i].D) / tasks[i].T + 1) * tasks[i].C;
+	return d;
+}
+
+/* EDF test of the tasks of "core". Returns 1 if schedulable, 0 if not
+ * (with the interval length where the demand exceeds it in *failAt,
+ * 0 if the utilization is above 1) and -1 if inconclusive (too many
+ * deadlines to check) */
+int SchedAnalysis_Edf(const struct saTask *tasks, int n, int core, uint64_t *failAt)
+{
+	uint64_t L = 0, Ln, t, points = 0;
+	int i, it;
+
+	*failAt = 0;
+	if(SchedAnalysis_Utilization(tasks, n, core) > 1.0)
+		return 0;
+
+	/* Synchronous busy period */
+	for(i = 0; i < n; i++)
+		if(tasks[i].core == core)
+			L += tasks[i].C;
+	for(it = 0; it < MAX_ITER; it++) {
+		for(i = 0, Ln = 0; i < n; i++)
+			if(tasks[i].core == core)
+				Ln += CeilDiv(L, tasks[i].T) * tasks[i].C;
+		if(Ln == L)
+			break;
+		L = Ln;
+	}
+	if(it == MAX_ITER)
+		return -1;
+
+	/* Demand at every absolute deadline in [0, L] */
+	for(i = 0; i < n; i++) {
+		if(tasks[i].core != core)
+			continue;
+		for(t = tasks[i].D; t <= L; t += tasks[i].T) {
+			if(++points > SA_MAX_DBF_POINTS)
+				return -1;
+			if(Dbf(tasks, n, core, t) > t) {
+				*failAt = t;
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/* Priorities: 99 for the first task in the order, 98 for the next, ... */
+static void AssignByKey(struct saTask *tasks, int n, int useDeadline)
+{
+	int i, j, rank;
+	uint64_t ki, kj;
+
+	for(i = 0; i < n; i++) {
+		ki = useDeadline ? tasks[i].D : tasks[i].T;
+		for(j = 0, rank = 0; j < n; j++) {
+			kj = useDeadline ? tasks[j].D : tasks[j].T;
+			if(kj < ki || (kj == ki && j < i))
+				rank++;
+		}
+		tasks[i].prio = rank < 98 ? 99 - rank : 1;
+	}
+}
+
+/* Deadline monotonic priorities */
+void SchedAnalysis_AssignDm(struct saTask *tasks, int n)
+{
+	AssignByKey(tasks, n, 1);
+}
+
+/* Rate monotonic priorities */
+void SchedAnalysis_AssignRm(struct saTask *tasks, int n)
+{
+	AssignByKey(tasks, n, 0);
+}
+
+/* Partitions the tasks over cores 0..ncores-1 (see schedAnalysis.h).
+ * Returns the number of tasks that could not be placed */
+int SchedAnalysis_Partition(struct saTask *tasks, int n, int ncores, enum saFit fit, enum saTest test)
+{
+	int order[SA_MAX_TASKS], cand[SA_MAX_TASKS], i, j, k, c, t, unassigned = 0;
+	double u[SA_MAX_TASKS] = { 0 }, ui;
+	uint64_t failAt;
+
+	if(n > SA_MAX_TASKS || ncores < 1 || ncores > SA_MAX_TASKS)
+		return n;
+
+	/* Decreasing utilization (stable) */
+	for(i = 0; i < n; i++) {
+		ui = (double)tasks[i].C / tasks[i].T;
+		for(j = i; j > 0 && (double)tasks[order[j - 1]].C / tasks[order[j - 1]].T < ui; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+		tasks[i].core = -1;
+	}
+
+	for(k = 0; k < n; k++) {
+		t = order[k];
+		/* Candidate cores: in order (first-fit) or by increasing load (worst-fit) */
+		for(c = 0; c < ncores; c++) {
+			for(j = c; fit == SA_WORST_FIT && j > 0 && u[cand[j - 1]] > u[c]; j--)
+				cand[j] = cand[j - 1];
+			cand[j] = c;
+		}
+		for(j = 0; j < ncores; j++) {
+			tasks[t].core = cand[j];
+			if(test == SA_TEST_EDF ? SchedAnalysis_Edf(tasks, n, cand[j], &failAt) == 1
+				: SchedAnalysis_Rta(tasks, n, cand[j]) == 0)
+				break;
+		}
+		if(j == ncores) {
+			tasks[t].core = -1;
+			unassigned++;
+		} else
+			u[cand[j]] += (double)tasks[t].C / tasks[t].T;
+	}
+
+	/* The tentative placements left the results (R) of the rejected
+	 * ones on their cores: redo the test with the final assignment */
+	for(c = 0; c < ncores; c++)
+		if(test == SA_TEST_EDF)
+			SchedAnalysis_Edf(tasks, n, c, &failAt);
+		else
+			SchedAnalysis_Rta(tasks, n, c);
+	return unassigned;
+}
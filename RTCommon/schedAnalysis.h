@@ -0,0 +1,54 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Schedulability analysis of periodic task sets
+ *
+ * Tasks are independent and periodic (or sporadic), with execution
+ * time C, period T, relative deadline D (any, D > T is allowed),
+ * priority (higher value, higher priority, as in SCHED_FIFO and
+ * Xenomai) and core. Each core is analysed on its own:
+ *	- fixed priority: exact response time analysis, with the level-i
+ *	  busy period for D > T (Lehoczky). Tasks with equal priority
+ *	  are assumed to interfere with each other (FIFO order)
+ *	- EDF: utilization and processor demand (dbf) test over the
+ *	  synchronous busy period
+ *
+ * SchedAnalysis_Partition() assigns the tasks to cores (partitioned
+ * scheduling): by decreasing utilization, each task goes to the first
+ * core (first-fit) or the least loaded core (worst-fit) where the
+ * per-core test above still succeeds with it. Tasks that fit nowhere
+ * are left with core -1.
+ *
+ * All times in ns.
+ *
+ *****************************************************************/
+
+#ifndef SCHED_ANALYSIS_H
+#define SCHED_ANALYSIS_H
+
+#include <stdint.h>
+
+#define SA_NAME_LEN 32
+#define SA_MAX_TASKS 256
+#define SA_MAX_DBF_POINTS 10000000	// Deadlines checked by the EDF test
+#define SA_UNBOUNDED UINT64_MAX		// Response time of an unschedulable task
+
+enum saFit { SA_FIRST_FIT, SA_WORST_FIT };
+enum saTest { SA_TEST_FP, SA_TEST_EDF };
+
+struct saTask {
+	char name[SA_NAME_LEN];
+	uint64_t C, T, D;
+	int prio;
+	int core;
+	uint64_t R;			// Worst-case response time (fixed priority)
+};
+
+double SchedAnalysis_Utilization(const struct saTask *tasks, int n, int core);
+int SchedAnalysis_Rta(struct saTask *tasks, int n, int core);
+int SchedAnalysis_Edf(const struct saTask *tasks, int n, int core, uint64_t *failAt);
+void SchedAnalysis_AssignDm(struct saTask *tasks, int n);
+void SchedAnalysis_AssignRm(struct saTask *tasks, int n);
+int SchedAnalysis_Partition(struct saTask *tasks, int n, int ncores, enum saFit fit, enum saTest test);
+
+#endif
@@ -0,0 +1,225 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Schedulability analyzer for a periodic task set
+ *
+ * Usage: schedAnalyzer [-p rm|dm] [-m TRACEFILE]... [-x MARGIN_PCT]
+ *		[-c NCORES [-f wf|ff] [-e]] TASKFILE
+ *		TASKFILE has one task per line (times in us, "#" starts a
+ *		comment):
+ *			NAME C T [D [PRIORITY [CORE]]]
+ *		D defaults to T, PRIORITY to 0 and CORE to 0. Higher
+ *		priority values are more urgent (SCHED_FIFO, Xenomai).
+ *
+ *		-p	assigns rate or deadline monotonic priorities instead
+ *			of those in the file
+ *		-m	takes C of the task with the trace's task name from
+ *			an activation trace (see actTrace.h): the longest
+ *			execution time recorded, plus MARGIN_PCT % (-x).
+ *			An "_" in NAME matches a space in the trace name
+ *			(e.g. Task_a for the "Task a" of periodicTask)
+ *		-c	partitions the tasks over NCORES cores instead of
+ *			using CORE of the file: worst-fit (default) or
+ *			first-fit decreasing (-f), with the fixed priority
+ *			or, with -e, the EDF test per core
+ *
+ *		For each core prints the utilization, the worst-case
+ *		response time and slack of each task under fixed priority,
+ *		and the EDF (processor demand) verdict. The exit status is
+ *		2 if some task can miss its deadline under fixed priority
+ *		(or, with -c, could not be placed).
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "schedAnalysis.h"
+#include "actTrace.h"
+
+struct saTask tasks[SA_MAX_TASKS];
+
+static int ReadTasks(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[256], *p;
+	double C, T, D;
+	int n = 0, lineno = 0, k;
+
+	if(f == NULL) {
+		perror(path);
+		return -1;
+	}
+	while(fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		if((p = strchr(line, '#')) != NULL)
+			*p = '\0';
+		if(n == SA_MAX_TASKS) {
+			fprintf(stderr, "%s: more than %d tasks\n", path, SA_MAX_TASKS);
+			break;
+		}
+		memset(&tasks[n], 0, sizeof(tasks[n]));
+		D = 0;
+		k = sscanf(line, "%31s %lf %lf %lf %d %d", tasks[n].name, &C, &T, &D,
+			&tasks[n].prio, &tasks[n].core);
+		if(k <= 0)
+			continue;
+		if(k < 3 || C <= 0 || T <= 0 || D < 0 || tasks[n].core < 0) {
+			fprintf(stderr, "%s:%d: expected NAME C T [D [PRIORITY [CORE]]]\n", path, lineno);
+			fclose(f);
+			return -1;
+		}
+		tasks[n].C = (uint64_t)(C * 1000);
+		tasks[n].T = (uint64_t)(T * 1000);
+		tasks[n].D = k >= 4 && D > 0 ? (uint64_t)(D * 1000) : tasks[n].T;
+		n++;
+	}
+	fclose(f);
+	return n;
+}
+
+/* Task names of the file have "_" for spaces */
+static int NameMatch(const char *file, const char *trace)
+{
+	for(; *file && *trace; file++, trace++)
+		if(*file != *trace && !(*file == '_' && *trace == ' '))
+			return 0;
+	return *file == *trace;
+}
+
+/* Replaces C of the matching task by the longest job of the trace */
+static int MeasuredC(const char *path, int n, double margin)
+{
+	struct actTrace t;
+	const struct actTraceRecord *r;
+	uint64_t count, i, c, maxC = 0;
+	int k, err;
+
+	err = ActTrace_Map(&t, path);
+	if(err) {
+		fprintf(stderr, "%s: not a valid trace file (%s)\n", path, strerror(-err));
+		return -1;
+	}
+	count = atomic_load(&t.hdr->count);
+	for(i = count > t.hdr->capacity ? count - t.hdr->capacity : 0; i < count; i++) {
+		r = &t.rec[i % t.hdr->capacity];
+		c = r->end > r->start ? r->end - r->start : 0;
+		if(c > maxC)
+			maxC = c;
+	}
+	for(k = 0; k < n; k++)
+		if(NameMatch(tasks[k].name, t.hdr->taskName))
+			break;
+	if(k == n)
+		fprintf(stderr, "%s: task \"%s\" is not in the task set\n", path, t.hdr->taskName);
+	else if(maxC == 0)
+		fprintf(stderr, "%s: no activations\n", path);
+	else {
+		tasks[k].C = (uint64_t)(maxC * (1.0 + margin / 100));
+		printf("C of %s from %s: %.3f us (longest of %llu jobs + %.1f%%)\n", tasks[k].name, path,
+			(double)tasks[k].C / 1000, (unsigned long long)(count < t.hdr->capacity ? count : t.hdr->capacity), margin);
+	}
+	ActTrace_Close(&t);
+	return k == n ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *traces[SA_MAX_TASKS], *prio = NULL, *fit = "wf";
+	int ntraces = 0, n, i, core, maxCore = 0, opt, misses, total = 0, edf, ncores = 0, edfTest = 0;
+	double margin = 0;
+	uint64_t failAt;
+
+	while((opt = getopt(argc, argv, "p:m:x:c:f:e")) != -1) {
+		switch(opt) {
+			case 'p':
+				prio = optarg;
+				break;
+			case 'm':
+				if(ntraces < SA_MAX_TASKS)
+					traces[ntraces++] = optarg;
+				break;
+			case 'x':
+				margin = atof(optarg);
+				break;
+			case 'c':
+				ncores = atoi(optarg);
+				if(ncores < 1 || ncores > SA_MAX_TASKS)
+					optind = argc;
+				break;
+			case 'f':
+				fit = optarg;
+				break;
+			case 'e':
+				edfTest = 1;
+				break;
+			default:
+				optind = argc;
+				break;
+		}
+	}
+	if(optind != argc - 1 || (prio != NULL && strcmp(prio, "rm") && strcmp(prio, "dm"))
+		|| (strcmp(fit, "wf") && strcmp(fit, "ff"))) {
+		printf("Usage: %s [-p rm|dm] [-m TRACEFILE]... [-x MARGIN_PCT] [-c NCORES [-f wf|ff] [-e]] TASKFILE\n", argv[0]);
+		return 1;
+	}
+
+	n = ReadTasks(argv[optind]);
+	if(n <= 0)
+		return 1;
+	for(i = 0; i < ntraces; i++)
+		MeasuredC(traces[i], n, margin);
+	if(prio != NULL && !strcmp(prio, "rm"))
+		SchedAnalysis_AssignRm(tasks, n);
+	else if(prio != NULL)
+		SchedAnalysis_AssignDm(tasks, n);
+	if(ncores) {
+		total = SchedAnalysis_Partition(tasks, n, ncores, strcmp(fit, "ff") ? SA_WORST_FIT : SA_FIRST_FIT,
+			edfTest ? SA_TEST_EDF : SA_TEST_FP);
+		printf("Partitioned over %d cores, %s decreasing, %s test: %d tasks not placed\n", ncores,
+			strcmp(fit, "ff") ? "worst-fit" : "first-fit", edfTest ? "EDF" : "fixed priority", total);
+		for(i = 0; i < n; i++)
+			if(tasks[i].core < 0)
+				printf("  %s (U %.4f) does not fit\n", tasks[i].name, (double)tasks[i].C / tasks[i].T);
+	}
+
+	for(i = 0; i < n; i++)
+		if(tasks[i].core > maxCore)
+			maxCore = tasks[i].core;
+
+	for(core = 0; core <= maxCore; core++) {
+		for(i = 0; i < n && tasks[i].core != core; i++);
+		if(i == n)
+			continue;
+
+		misses = SchedAnalysis_Rta(tasks, n, core);
+		total += misses;
+		printf("\nCore %d: utilization %.4f\n", core, SchedAnalysis_Utilization(tasks, n, core));
+		printf("  %-16s %12s %12s %12s %5s %14s %14s\n", "task", "C(us)", "T(us)", "D(us)", "prio", "WCRT(us)", "slack(us)");
+		for(i = 0; i < n; i++) {
+			if(tasks[i].core != core)
+				continue;
+			printf("  %-16s %12.3f %12.3f %12.3f %5d ", tasks[i].name, (double)tasks[i].C / 1000,
+				(double)tasks[i].T / 1000, (double)tasks[i].D / 1000, tasks[i].prio);
+			if(tasks[i].R == SA_UNBOUNDED)
+				printf("%14s %14s  INFEASIBLE\n", "unbounded", "-");
+			else
+				printf("%14.3f %14.3f%s\n", (double)tasks[i].R / 1000,
+					((double)tasks[i].D - (double)tasks[i].R) / 1000, tasks[i].R > tasks[i].D ? "  INFEASIBLE" : "");
+		}
+		printf("  Fixed priority: %s\n", misses ? "NOT schedulable" : "schedulable");
+
+		edf = SchedAnalysis_Edf(tasks, n, core, &failAt);
+		if(edf > 0)
+			printf("  EDF: schedulable\n");
+		else if(edf < 0)
+			printf("  EDF: inconclusive (busy period too long to check)\n");
+		else if(failAt == 0)
+			printf("  EDF: NOT schedulable (utilization above 1)\n");
+		else
+			printf("  EDF: NOT schedulable (demand exceeds the interval at t = %.3f us)\n", (double)failAt / 1000);
+	}
+	return total ? 2 : 0;
+}
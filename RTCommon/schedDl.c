@@ -0,0 +1,77 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * SCHED_DEADLINE support - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+
+#include "schedDl.h"
+
+/* Layout of the kernel's struct sched_attr (not in every libc) */
+struct schedDlAttr {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+static _Atomic uint64_t throttled;
+
+static void CatchXcpu(int sig)
+{
+	(void)sig;
+	atomic_fetch_add_explicit(&throttled, 1, memory_order_relaxed);
+}
+
+/* Returns 0 or -errno */
+int SchedDl_Set(uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns)
+{
+	struct schedDlAttr attr;
+	struct sigaction sa;
+	cpu_set_t cpuset;
+	long i, ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = CatchXcpu;
+	sigaction(SIGXCPU, &sa, NULL);
+
+	CPU_ZERO(&cpuset);
+	for(i = 0; i < ncpus; i++)
+		CPU_SET(i, &cpuset);
+	sched_setaffinity(0, sizeof(cpuset), &cpuset);
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.sched_policy = SCHED_DEADLINE;
+	attr.sched_flags = SCHEDDL_FLAG_DL_OVERRUN;
+	attr.sched_runtime = runtime_ns;
+	attr.sched_deadline = deadline_ns;
+	attr.sched_period = period_ns;
+	if(syscall(SYS_sched_setattr, 0, &attr, 0) == 0)
+		return 0;
+
+	/* Kernels before 4.16 reject the overrun flag: go on without it */
+	attr.sched_flags = 0;
+	if(errno == EINVAL && syscall(SYS_sched_setattr, 0, &attr, 0) == 0)
+		return 0;
+	return -errno;
+}
+
+/* Throttling events (runtime exhausted) reported by the kernel */
+uint64_t SchedDl_Throttled(void)
+{
+	return atomic_load(&throttled);
+}
@@ -0,0 +1,40 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * SCHED_DEADLINE (EDF + CBS) support
+ *
+ * SchedDl_Set() moves the calling thread to SCHED_DEADLINE with the
+ * given runtime/deadline/period, through the sched_setattr syscall.
+ * The thread then signals the end of each job with sched_yield():
+ * it is suspended until its next period, with a full runtime.
+ *
+ * A job that consumes its runtime before calling sched_yield() is
+ * throttled by the CBS until the next period. The kernel reports it
+ * with SIGXCPU (SCHED_FLAG_DL_OVERRUN); SchedDl_Throttled() counts
+ * those events. The check is done on the scheduler tick, so jobs
+ * shorter than a tick are seldom signalled: compare the CPU time of
+ * the job (CLOCK_THREAD_CPUTIME_ID) with the runtime as well.
+ *
+ * Known issues and limitations:
+ *		- The kernel only admits SCHED_DEADLINE threads whose
+ *		  affinity spans their whole root domain, so SchedDl_Set()
+ *		  resets the affinity of the thread to all online CPUs
+ *		  (use cpusets to confine it)
+ *		- Requires root (CAP_SYS_NICE)
+ *
+ *****************************************************************/
+
+#ifndef SCHED_DL_H
+#define SCHED_DL_H
+
+#include <stdint.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+#define SCHEDDL_FLAG_DL_OVERRUN 0x04	// SCHED_FLAG_DL_OVERRUN: SIGXCPU when throttled
+
+int SchedDl_Set(uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns);
+uint64_t SchedDl_Throttled(void);
+
+#endif
@@ -0,0 +1,279 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Streaming filters for the sensor pipeline - implementation
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sensorFilter.h"
+
+/* ******************
+ * Sliding median
+ * ******************/
+
+/* The heap holds indices into x: heap[0] is the median, heap[-1],
+ * heap[-2], ... a max-heap of the lower half (parent of i: i/2, which
+ * rounds towards 0) and heap[1], heap[2], ... a min-heap of the upper
+ * half. pos[] gives where each sample of the ring buffer is, so the
+ * one leaving the window is replaced in place and sifted */
+#define MIN_CT(f) (((f)->n - 1) / 2)
+#define MAX_CT(f) ((f)->n / 2)
+
+static int HeapLess(struct filter *f, int i, int j)
+{
+	return f->x[f->heap[i]] < f->x[f->heap[j]];
+}
+
+/* Swaps heap[i] and heap[j] if x of heap[i] < x of heap[j]. Returns 1 if swapped */
+static int HeapCmpExch(struct filter *f, int i, int j)
+{
+	int t;
+
+	if(!HeapLess(f, i, j))
+		return 0;
+	t = f->heap[i];
+	f->heap[i] = f->heap[j];
+	f->heap[j] = t;
+	f->pos[f->heap[i]] = i;
+	f->pos[f->heap[j]] = j;
+	return 1;
+}
+
+/* Sift down from heap[i / 2]: i is its first child, or the root
+ * (1, -1) of a half for the median */
+static void MinSortDown(struct filter *f, int i)
+{
+	for(; i <= MIN_CT(f); i *= 2) {
+		if(i > 1 && i < MIN_CT(f) && HeapLess(f, i + 1, i))
+			i++;
+		if(!HeapCmpExch(f, i, i / 2))
+			break;
+	}
+}
+
+static void MaxSortDown(struct filter *f, int i)
+{
+	for(; i >= -MAX_CT(f); i *= 2) {
+		if(i < -1 && i > -MAX_CT(f) && HeapLess(f, i, i - 1))
+			i--;
+		if(!HeapCmpExch(f, i / 2, i))
+			break;
+	}
+}
+
+/* Sift up, through the median. Return 1 if the sample became the median */
+static int MinSortUp(struct filter *f, int i)
+{
+	while(i > 0 && HeapCmpExch(f, i, i / 2))
+		i /= 2;
+	return i == 0;
+}
+
+static int MaxSortUp(struct filter *f, int i)
+{
+	while(i < 0 && HeapCmpExch(f, i / 2, i))
+		i /= 2;
+	return i == 0;
+}
+
+static double MedianStep(struct filter *f, double v)
+{
+	int isNew = f->n < f->w;
+	int p = f->pos[f->idx];
+	double old = f->x[f->idx];
+
+	f->x[f->idx] = v;
+	f->idx = (f->idx + 1) % f->w;
+	f->n += isNew;
+	if(p > 0) { // In the min-heap
+		if(!isNew && old < v)
+			MinSortDown(f, p * 2);
+		else if(MinSortUp(f, p))
+			MaxSortDown(f, -1);
+	} else if(p < 0) { // In the max-heap
+		if(!isNew && v < old)
+			MaxSortDown(f, p * 2);
+		else if(MaxSortUp(f, p))
+			MinSortDown(f, 1);
+	} else { // The median
+		if(MAX_CT(f))
+			MaxSortDown(f, -1);
+		if(MIN_CT(f))
+			MinSortDown(f, 1);
+	}
+
+	if(f->n % 2 == 0)
+		return (f->x[f->heap[0]] + f->x[f->heap[-1]]) / 2;
+	return f->x[f->heap[0]];
+}
+
+/* ******************
+ * Filters
+ * ******************/
+
+static int ParseWindow(const char *arg, int max)
+{
+	char *end;
+	long w = strtol(arg, &end, 10);
+
+	return end != arg && *end == '\0' && w >= 1 && w <= max ? (int)w : -1;
+}
+
+/* Parses "spec" (see sensorFilter.h) and allocates the filter.
+ * Returns 0, -EINVAL if the spec is invalid or -ENOMEM */
+int Filter_Init(struct filter *f, const char *spec)
+{
+	const char *arg = strchr(spec, ':');
+	size_t len = arg != NULL ? (size_t)(arg - spec) : strlen(spec);
+	char *end;
+	int i;
+
+	memset(f, 0, sizeof(*f));
+	if(arg != NULL)
+		arg++;
+
+	if(len == 4 && strncmp(spec, "none", len) == 0) {
+		f->type = FILTER_NONE;
+		return arg == NULL ? 0 : -EINVAL;
+	} else if(len == 3 && strncmp(spec, "ema", len) == 0) {
+		f->type = FILTER_EMA;
+		if(arg == NULL)
+			return -EINVAL;
+		f->alpha = strtod(arg, &end);
+		return end != arg && *end == '\0' && f->alpha > 0 && f->alpha <= 1 ? 0 : -EINVAL;
+	} else if(len == 2 && strncmp(spec, "ma", len) == 0) {
+		f->type = FILTER_MA;
+		if(arg == NULL || (f->w = ParseWindow(arg, FILTER_MAX_WINDOW)) < 0)
+			return -EINVAL;
+		f->x = calloc(f->w, sizeof(*f->x));
+		return f->x != NULL ? 0 : -ENOMEM;
+	} else if(len == 6 && strncmp(spec, "median", len) == 0) {
+		f->type = FILTER_MEDIAN;
+		if(arg == NULL || (f->w = ParseWindow(arg, FILTER_MAX_WINDOW)) < 0)
+			return -EINVAL;
+		f->x = calloc(f->w, sizeof(*f->x));
+		f->pos = calloc(f->w, sizeof(*f->pos));
+		f->heapBuf = calloc(f->w, sizeof(*f->heapBuf));
+		if(f->x == NULL || f->pos == NULL || f->heapBuf == NULL) {
+			Filter_Free(f);
+			return -ENOMEM;
+		}
+		/* Initial places: median, max, min, max, min, ... */
+		f->heap = f->heapBuf + f->w / 2;
+		for(i = 0; i < f->w; i++) {
+			f->pos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+			f->heap[f->pos[i]] = i;
+		}
+		return 0;
+	} else if(len == 3 && strncmp(spec, "fir", len) == 0) {
+		f->type = FILTER_FIR;
+		if(arg == NULL)
+			return -EINVAL;
+		f->h = calloc(FILTER_MAX_TAPS, sizeof(*f->h));
+		if(f->h == NULL)
+			return -ENOMEM;
+		for(;;) {
+			if(f->w == FILTER_MAX_TAPS) {
+				Filter_Free(f);
+				return -EINVAL;
+			}
+			f->h[f->w++] = strtod(arg, &end);
+			if(end == arg || (*end != ',' && *end != '\0')) {
+				Filter_Free(f);
+				return -EINVAL;
+			}
+			if(*end == '\0')
+				break;
+			arg = end + 1;
+		}
+		f->x = calloc(2 * f->w, sizeof(*f->x));
+		if(f->x == NULL) {
+			Filter_Free(f);
+			return -ENOMEM;
+		}
+		return 0;
+	}
+	return -EINVAL;
+}
+
+void Filter_Free(struct filter *f)
+{
+	free(f->x);
+	free(f->h);
+	free(f->pos);
+	free(f->heapBuf);
+	f->x = f->h = NULL;
+	f->pos = f->heapBuf = f->heap = NULL;
+}
+
+/* Feeds sample "x". Returns 1 with the output in *y, or 0 while the
+ * window of the filter is not full yet */
+int Filter_Step(struct filter *f, double x, double *y)
+{
+	double acc;
+	int k;
+
+	switch(f->type) {
+		case FILTER_NONE:
+			*y = x;
+			return 1;
+		case FILTER_EMA:
+			f->y = f->n ? f->y + f->alpha * (x - f->y) : x;
+			f->n = 1;
+			*y = f->y;
+			return 1;
+		case FILTER_MA:
+			f->sum += x - f->x[f->idx];
+			f->x[f->idx] = x;
+			f->idx = (f->idx + 1) % f->w;
+			if(f->n < f->w && ++f->n < f->w)
+				return 0;
+			*y = f->sum / f->w;
+			return 1;
+		case FILTER_MEDIAN:
+			acc = MedianStep(f, x);
+			if(f->n < f->w)
+				return 0;
+			*y = acc;
+			return 1;
+		case FILTER_FIR:
+			/* Each sample is kept twice, at idx and idx + w, so that
+			 * the last w are contiguous: x[idx + 1 .. idx + w] */
+			f->x[f->idx] = f->x[f->idx + f->w] = x;
+			for(k = 0, acc = 0; k < f->w; k++)
+				acc += f->h[k] * f->x[f->idx + f->w - k];
+			f->idx = (f->idx + 1) % f->w;
+			if(f->n < f->w && ++f->n < f->w)
+				return 0;
+			*y = acc;
+			return 1;
+	}
+	return 0;
+}
+
+const char *Filter_Describe(const struct filter *f, char *buf, size_t size)
+{
+	switch(f->type) {
+		case FILTER_NONE:
+			snprintf(buf, size, "none");
+			break;
+		case FILTER_MA:
+			snprintf(buf, size, "moving average, window %d", f->w);
+			break;
+		case FILTER_EMA:
+			snprintf(buf, size, "exponential moving average, alpha %g", f->alpha);
+			break;
+		case FILTER_MEDIAN:
+			snprintf(buf, size, "sliding median, window %d", f->w);
+			break;
+		case FILTER_FIR:
+			snprintf(buf, size, "FIR, %d taps", f->w);
+			break;
+	}
+	return buf;
+}
@@ -0,0 +1,56 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Streaming filters for the sensor pipeline
+ *
+ * A filter is given as a spec string:
+ *	none			output = input
+ *	ma:W			moving average of the last W samples
+ *				(running sum over a ring buffer, O(1))
+ *	ema:ALPHA		exponential moving average, 0 < ALPHA <= 1
+ *				(y += ALPHA * (x - y), O(1))
+ *	median:W		median of the last W samples (mean of
+ *				the two middle ones if W is even), with
+ *				a max-heap/min-heap pair indexed by the
+ *				ring buffer position, O(log W)
+ *	fir:H0,H1,...		FIR, y = sum Hk * x[n-k], O(taps)
+ *
+ * Filter_Init() allocates everything; Filter_Step() does not
+ * allocate, so it can run in the RT task (with the memory locked).
+ * The windowed filters (ma, median, fir) give no output until their
+ * window is full. The running sum of ma is exact for integer samples
+ * (as long as it stays below 2^53).
+ *
+ *****************************************************************/
+
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <stddef.h>
+
+#define FILTER_MAX_WINDOW 65536		// Longest ma/median window
+#define FILTER_MAX_TAPS 256		// Longest FIR
+
+enum filterType { FILTER_NONE, FILTER_MA, FILTER_EMA, FILTER_MEDIAN, FILTER_FIR };
+
+struct filter {
+	enum filterType type;
+	int w;				// Window (ma, median) or taps (fir)
+	double alpha;			// ema
+	double *x;			// Last w samples, ring buffer (fir: twice, see Filter_Step)
+	double *h;			// fir coefficients
+	int idx;			// Position of the next sample in x
+	int n;				// Samples so far, up to w
+	double sum;			// ma: sum of x
+	double y;			// ema: output
+	int *pos;			// median: heap position of each x
+	int *heapBuf, *heap;		// median: heap[0] is the median, the max-heap at heap[-1..],
+					// the min-heap at heap[1..]
+};
+
+int Filter_Init(struct filter *f, const char *spec);
+void Filter_Free(struct filter *f);
+int Filter_Step(struct filter *f, double x, double *y);
+const char *Filter_Describe(const struct filter *f, char *buf, size_t size);
+
+#endif
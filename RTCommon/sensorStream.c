@@ -0,0 +1,114 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Streaming reader of recorded sensor data - implementation
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sensorStream.h"
+
+/* Maps and prefaults the file. Returns 0 or -errno (-ENODATA if empty) */
+int SensorStream_Open(struct sensorStream *s, const char *path, enum sensorEof eof)
+{
+	struct stat st;
+	void *p;
+	int fd, err;
+
+	memset(s, 0, sizeof(*s));
+	s->eof = eof;
+	fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return -errno;
+	if(fstat(fd, &st)) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	if(st.st_size == 0) {
+		close(fd);
+		return -ENODATA;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	err = p == MAP_FAILED ? -errno : 0;
+	close(fd); // The mapping keeps the file
+	if(err)
+		return err;
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+	s->data = p;
+	s->size = st.st_size;
+	return 0;
+}
+
+/* Parses an integer in [p, end), with optional sign and blanks around.
+ * Returns 0, or -1 if it is not one */
+static int ParseInt(const char *p, const char *end, int32_t *value)
+{
+	int64_t v = 0;
+	int neg = 0;
+
+	while(p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	if(p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+	if(p == end || *p < '0' || *p > '9')
+		return -1;
+	for(; p < end && *p >= '0' && *p <= '9'; p++)
+		if((v = v * 10 + (*p - '0')) > (int64_t)INT32_MAX + 1)
+			return -1;
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	if(p != end || (!neg && v > INT32_MAX))
+		return -1;
+	*value = (int32_t)(neg ? -v : v);
+	return 0;
+}
+
+/* Parses the next sample into "smp" (but its timestamp, left to the
+ * caller). Returns 1, or 0 at the end of the data (stop mode) */
+int SensorStream_Read(struct sensorStream *s, struct sensorSample *smp)
+{
+	const char *start, *end;
+	int wrapped = 0;
+
+	for(;;) {
+		if(s->pos >= s->size) {
+			if(s->eof == SENSOR_EOF_STOP || wrapped)
+				return 0; // Stop, or a file without samples
+			s->pos = 0;
+			s->loops++;
+			wrapped = 1;
+		}
+		start = s->data + s->pos;
+		end = memchr(start, '\n', s->size - s->pos);
+		if(end == NULL)
+			end = s->data + s->size; // Last line, without '\n'
+		s->pos = end - s->data + 1;
+
+		if(end == start || (end == start + 1 && *start == '\r'))
+			continue; // Empty line
+		if(ParseInt(start, end, &smp->value) == 0)
+			break;
+		s->bad++;
+	}
+
+	smp->seq = s->samples++;
+	smp->channel = s->channel;
+	return 1;
+}
+
+void SensorStream_Close(struct sensorStream *s)
+{
+	if(s->data != NULL)
+		munmap((void *)s->data, s->size);
+	s->data = NULL;
+}
@@ -0,0 +1,54 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Streaming reader of recorded sensor data
+ *
+ * The data file (one sample per line, as text) is mapped and
+ * prefaulted once, by SensorStream_Open(), outside the periodic
+ * loop. SensorStream_Read() then parses the sample at the cursor
+ * into a struct sensorSample and advances it: O(1) in the size of
+ * the file, without syscalls or page faults (with the memory locked,
+ * see mlockall). Empty lines are skipped, as are lines that are not
+ * an integer (counted in "bad").
+ *
+ * The samples travel through the pipeline queues as sensorSample
+ * records: fixed size, parsed once here and only formatted again by
+ * the stage that stores them.
+ *
+ * At the end of the file the stream either stops or loops back to
+ * the first sample (SENSOR_EOF_LOOP).
+ *
+ *****************************************************************/
+
+#ifndef SENSOR_STREAM_H
+#define SENSOR_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* A sample, as it goes through the pipeline */
+struct sensorSample {
+	uint64_t seq;			// Sequence number, from 0
+	uint64_t timestamp;		// Acquisition time (ns)
+	int32_t value;
+	uint32_t channel;		// Sensor id
+};
+
+enum sensorEof { SENSOR_EOF_STOP, SENSOR_EOF_LOOP };
+
+struct sensorStream {
+	const char *data;		// Mapped file
+	size_t size;
+	size_t pos;			// Cursor: start of the next line
+	enum sensorEof eof;
+	uint32_t channel;		// Channel of the samples
+	uint64_t samples;		// Samples delivered
+	uint64_t bad;			// Lines skipped, not an integer
+	uint64_t loops;			// Times the end of the file was reached (loop mode)
+};
+
+int SensorStream_Open(struct sensorStream *s, const char *path, enum sensorEof eof);
+int SensorStream_Read(struct sensorStream *s, struct sensorSample *smp);
+void SensorStream_Close(struct sensorStream *s);
+
+#endif
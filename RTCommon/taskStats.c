@@ -0,0 +1,56 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Per activation accounting of a periodic task - implementation
+ *
+ *****************************************************************/
+
+#include "taskStats.h"
+
+static uint64_t Diff(uint64_t a, uint64_t b)
+{
+	return a > b ? a - b : 0;
+}
+
+void TaskStats_Init(struct taskStats *s, uint64_t deadline_ns)
+{
+	s->deadline_ns = deadline_ns;
+	s->jobs = 0;
+	s->misses = 0;
+	s->worstResp_ns = 0;
+	s->worstJob = 0;
+	HdrHist_Init(&s->release, HDR_DEFAULT_PRECISION_BITS);
+	HdrHist_Init(&s->exec, HDR_DEFAULT_PRECISION_BITS);
+	HdrHist_Init(&s->resp, HDR_DEFAULT_PRECISION_BITS);
+}
+
+/* Records one job (RT side). Returns 1 if it missed its deadline */
+int TaskStats_Record(struct taskStats *s, uint64_t release, uint64_t wakeup,
+					 uint64_t start, uint64_t end)
+{
+	uint64_t resp = Diff(end, release);
+
+	s->jobs++;
+	HdrHist_Record(&s->release, Diff(wakeup, release));
+	HdrHist_Record(&s->exec, Diff(end, start));
+	HdrHist_Record(&s->resp, resp);
+	if(resp > s->worstResp_ns) {
+		s->worstResp_ns = resp;
+		s->worstJob = s->jobs;
+	}
+	if(resp > s->deadline_ns) {
+		s->misses++;
+		return 1;
+	}
+	return 0;
+}
+
+void TaskStats_Print(const struct taskStats *s, const char *name, FILE *out)
+{
+	fprintf(out, "%s: %llu jobs, deadline %.3f us, %llu deadline misses (%.3f%%), worst response at job %llu\n",
+		name, (unsigned long long)s->jobs, (double)s->deadline_ns / 1000, (unsigned long long)s->misses,
+		s->jobs ? 100.0 * s->misses / s->jobs : 0.0, (unsigned long long)s->worstJob);
+	HdrHist_Print(&s->release, "  Release latency", out);
+	HdrHist_Print(&s->exec, "  Execution time", out);
+	HdrHist_Print(&s->resp, "  Response time", out);
+}
@@ -0,0 +1,39 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Per activation accounting of a periodic task
+ *
+ * For every job, from its expected release, actual wakeup and work
+ * start/end (absolute, ns), records the release latency (wakeup -
+ * release), execution time (end - start) and response time (end -
+ * release) distributions and checks the response time against the
+ * relative deadline. Recording only updates the histograms (see
+ * hdrHist.h), so it can be done in the periodic loop.
+ *
+ *****************************************************************/
+
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "hdrHist.h"
+
+struct taskStats {
+	uint64_t deadline_ns;		// Relative deadline
+	uint64_t jobs;			// Jobs recorded
+	uint64_t misses;		// Jobs that finished after their deadline
+	uint64_t worstResp_ns;		// Response time of the worst job...
+	uint64_t worstJob;		// ... and its number
+	struct hdrHist release;		// Release latency
+	struct hdrHist exec;		// Execution time
+	struct hdrHist resp;		// Response time
+};
+
+void TaskStats_Init(struct taskStats *s, uint64_t deadline_ns);
+int TaskStats_Record(struct taskStats *s, uint64_t release, uint64_t wakeup,
+					 uint64_t start, uint64_t end);
+void TaskStats_Print(const struct taskStats *s, const char *name, FILE *out);
+
+#endif
@@ -0,0 +1,123 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Offline reader for activation traces (see actTrace.h)
+ *
+ * Usage: traceReader [-c CSVFILE] TRACEFILE...
+ *		Prints, for each trace, the release latency, inter-arrival
+ *		jitter, execution time and response time distributions.
+ *		With -c, also exports every activation to CSVFILE ("-" for
+ *		stdout, in which case the statistics go to stderr).
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "actTrace.h"
+#include "hdrHist.h"
+
+struct hdrHist rel_hist, jitter_hist, exec_hist, resp_hist;
+
+static uint64_t Diff(uint64_t a, uint64_t b)
+{
+	return a > b ? a - b : 0;
+}
+
+static int ProcessTrace(const char *path, FILE *csv, FILE *out)
+{
+	struct actTrace t;
+	const struct actTraceRecord *r, *prev = NULL;
+	uint64_t count, first, n, i, overruns = 0, misses = 0, flagged = 0;
+	int err;
+
+	err = ActTrace_Map(&t, path);
+	if(err) {
+		fprintf(stderr, "%s: not a valid trace file (%s)\n", path, strerror(-err));
+		return -1;
+	}
+
+	/* The trace is circular: when it wrapped, the oldest activation
+	 * is the one right after the last written */
+	count = atomic_load(&t.hdr->count);
+	n = count < t.hdr->capacity ? count : t.hdr->capacity;
+	first = count - n;
+
+	HdrHist_Init(&rel_hist, HDR_DEFAULT_PRECISION_BITS);
+	HdrHist_Init(&jitter_hist, HDR_DEFAULT_PRECISION_BITS);
+	HdrHist_Init(&exec_hist, HDR_DEFAULT_PRECISION_BITS);
+	HdrHist_Init(&resp_hist, HDR_DEFAULT_PRECISION_BITS);
+
+	for(i = first; i < count; i++) {
+		r = &t.rec[i % t.hdr->capacity];
+
+		HdrHist_Record(&rel_hist, Diff(r->wakeup, r->release));
+		HdrHist_Record(&exec_hist, Diff(r->end, r->start));
+		HdrHist_Record(&resp_hist, Diff(r->end, r->release));
+		if(prev != NULL && r->seq == prev->seq + 1)
+			HdrHist_Record(&jitter_hist, llabs((int64_t)(r->wakeup - prev->wakeup) - (int64_t)t.hdr->period_ns));
+		if(r->flags & ACT_TRACE_F_OVERRUN)
+			overruns++;
+		if(Diff(r->end, r->release) > t.hdr->period_ns)
+			misses++;
+		if(r->flags & ACT_TRACE_F_DEADLINE_MISS)
+			flagged++;
+
+		if(csv != NULL)
+			fprintf(csv, "%s,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%u\n", t.hdr->taskName, r->seq,
+				(unsigned long long)r->release, (unsigned long long)r->wakeup,
+				(unsigned long long)r->start, (unsigned long long)r->end,
+				(unsigned long long)Diff(r->wakeup, r->release),
+				(unsigned long long)Diff(r->end, r->start),
+				(unsigned long long)Diff(r->end, r->release), r->flags);
+		prev = r;
+	}
+
+	fprintf(out, "Trace %s: task %s, period %.3f us, %llu activations (%llu in file)\n", path, t.hdr->taskName,
+		(double)t.hdr->period_ns / 1000, (unsigned long long)count, (unsigned long long)n);
+	HdrHist_Print(&rel_hist, "  Release latency", out);
+	HdrHist_Print(&jitter_hist, "  Inter-arrival jitter", out);
+	HdrHist_Print(&exec_hist, "  Execution time", out);
+	HdrHist_Print(&resp_hist, "  Response time", out);
+	fprintf(out, "  Overruns: %llu / Deadline misses (D=T): %llu / (task deadline): %llu\n",
+		(unsigned long long)overruns, (unsigned long long)misses, (unsigned long long)flagged);
+
+	ActTrace_Close(&t);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *csv = NULL;
+	int opt, i, err = 0;
+
+	while((opt = getopt(argc, argv, "c:")) != -1) {
+		switch(opt) {
+			case 'c':
+				csv = strcmp(optarg, "-") ? fopen(optarg, "w") : stdout;
+				if(csv == NULL) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default:
+				optind = argc + 1;
+				break;
+		}
+	}
+	if(optind >= argc) {
+		printf("Usage: %s [-c CSVFILE] TRACEFILE...\n", argv[0]);
+		return 1;
+	}
+
+	if(csv != NULL)
+		fprintf(csv, "task,seq,release_ns,wakeup_ns,start_ns,end_ns,release_latency_ns,exec_ns,response_ns,flags\n");
+	for(i = optind; i < argc; i++)
+		if(ProcessTrace(argv[i], csv, csv == stdout ? stderr : stdout))
+			err = 1;
+	if(csv != NULL && csv != stdout)
+		fclose(csv);
+	return err;
+}
@@ -0,0 +1,92 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Microbenchmark for the timestamp sources (see tsClock.h)
+ *
+ * Usage: tsBench [ITERATIONS]
+ *		Prints the mean cost of one timestamp for each source and,
+ *		after the benchmark, the difference between TsClock_Now_ns()
+ *		and CLOCK_MONOTONIC (calibration error).
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tsClock.h"
+
+#define NS_IN_SEC 1000000000L
+
+static volatile int64_t sink;	// Keeps the reads from being optimized away
+
+static int64_t Now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (int64_t)t.tv_sec * NS_IN_SEC + t.tv_nsec;
+}
+
+static int64_t Read_Monotonic(void) { return TsClock_Gettime_ns(); }
+static int64_t Read_MonotonicRaw(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return t.tv_nsec;
+}
+static int64_t Read_TsClock(void) { return TsClock_Now_ns(); }
+#ifdef TSCLOCK_X86
+static int64_t Read_Rdtsc(void) { return __rdtsc(); }
+static int64_t Read_Rdtscp(void) { unsigned int aux; return __rdtscp(&aux); }
+#endif
+
+struct source {
+	const char *name;
+	int64_t (*read)(void);
+};
+
+static const struct source sources[] = {
+	{ "clock_gettime(MONOTONIC)", Read_Monotonic },
+	{ "clock_gettime(MONOTONIC_RAW)", Read_MonotonicRaw },
+#ifdef TSCLOCK_X86
+	{ "rdtsc (raw ticks)", Read_Rdtsc },
+	{ "rdtscp (raw ticks)", Read_Rdtscp },
+#endif
+	{ "TsClock_Now_ns", Read_TsClock },
+	{ NULL, NULL }
+};
+
+int main(int argc, char *argv[])
+{
+	long iters = argc > 1 ? atol(argv[1]) : 10000000;
+	int64_t t0, err, best;
+	long i;
+	int s;
+
+	if(iters < 1) {
+		printf("Usage: %s [ITERATIONS]\n", argv[0]);
+		return 1;
+	}
+
+	TsClock_Init(1);
+	printf("TsClock source: %s\n", TsClock_Source());
+	printf("%-30s %10s\n", "source", "ns/read");
+	for(s = 0; sources[s].name != NULL; s++) {
+		t0 = Now_ns();
+		for(i = 0; i < iters; i++)
+			sink = sources[s].read();
+		printf("%-30s %10.2f\n", sources[s].name, (double)(Now_ns() - t0) / iters);
+	}
+
+	/* Calibration error: smallest |TsClock - CLOCK_MONOTONIC| of a few reads */
+	for(i = 0, best = INT64_MAX; i < 16; i++) {
+		t0 = Now_ns();
+		err = TsClock_Now_ns() - t0;
+		if(llabs(err) < llabs(best))
+			best = err;
+	}
+	printf("TsClock_Now_ns - CLOCK_MONOTONIC: %lld ns\n", (long long)best);
+	return 0;
+}
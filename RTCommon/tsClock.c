@@ -0,0 +1,157 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Low overhead timestamps - implementation
+ *
+ *****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tsClock.h"
+
+#ifdef TSCLOCK_X86
+#include <cpuid.h>
+#endif
+
+#define NS_IN_SEC 1000000000L
+#define PAIR_TRIES 16	// Reads to find a tight TSC/clock pair
+
+struct tsClock tsClock = { .useTsc = 0, .reason = "not initialized" };
+
+#ifdef TSCLOCK_X86
+
+static int64_t ClockNs(clockid_t clk)
+{
+	struct timespec t;
+
+	clock_gettime(clk, &t);
+	return (int64_t)t.tv_sec * NS_IN_SEC + t.tv_nsec;
+}
+
+/* Reads clk and the TSC at (almost) the same instant: the TSC is the
+ * midpoint of the tightest of PAIR_TRIES reads */
+static void ReadPair(clockid_t clk, uint64_t *tsc, int64_t *ns)
+{
+	uint64_t t0, t1, best = UINT64_MAX;
+	unsigned int aux;
+	int64_t c;
+	int i;
+
+	for(i = 0; i < PAIR_TRIES; i++) {
+		t0 = __rdtscp(&aux);
+		c = ClockNs(clk);
+		t1 = __rdtscp(&aux);
+		if(t1 - t0 < best) {
+			best = t1 - t0;
+			*tsc = t0 + (t1 - t0) / 2;
+			*ns = c;
+		}
+	}
+}
+
+/* Invariant TSC and rdtscp (CPUID), and the kernel did not mark the
+ * TSC as unstable (its clocksource is "tsc") */
+static const char *TscUsable(void)
+{
+	unsigned int a, b, c, d;
+	char cs[32] = "";
+	FILE *f;
+
+	if(!__get_cpuid(0x80000001, &a, &b, &c, &d) || !(d & (1u << 27)))
+		return "no rdtscp";
+	if(!__get_cpuid(0x80000007, &a, &b, &c, &d) || !(d & (1u << 8)))
+		return "TSC not invariant";
+
+	f = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+	if(f != NULL) {
+		if(fgets(cs, sizeof(cs), f) != NULL && strncmp(cs, "tsc", 3) != 0) {
+			fclose(f);
+			return "kernel clocksource is not tsc";
+		}
+		fclose(f);
+	}
+	return NULL;
+}
+
+#endif
+
+/* Selects the timestamp source and calibrates the TSC (takes about
+ * TSCLOCK_CAL_NS; call at startup). Returns 1 if the TSC is used */
+int TsClock_Init(int allowTsc)
+{
+#ifdef TSCLOCK_X86
+	uint64_t tscA = 0, tscB = 0;
+	int64_t nsA = 0, nsB = 0;
+	struct timespec wait = { TSCLOCK_CAL_NS / NS_IN_SEC, TSCLOCK_CAL_NS % NS_IN_SEC };
+
+	tsClock.useTsc = 0;
+	tsClock.reason = allowTsc ? TscUsable() : "disabled";
+	if(tsClock.reason != NULL)
+		return 0;
+
+	/* Rate and offset, against CLOCK_MONOTONIC (NTP corrected, as the
+	 * clock_nanosleep() times): followed afterwards by TsClock_Resync() */
+	ReadPair(CLOCK_MONOTONIC, &tscA, &nsA);
+	nanosleep(&wait, NULL);
+	ReadPair(CLOCK_MONOTONIC, &tscB, &nsB);
+	if(tscB <= tscA || nsB <= nsA) {
+		tsClock.reason = "calibration failed";
+		return 0;
+	}
+	tsClock.ghz = (double)(tscB - tscA) / (nsB - nsA);
+	tsClock.mult = (uint64_t)(((unsigned __int128)(nsB - nsA) << TSCLOCK_SHIFT) / (tscB - tscA));
+	tsClock.resyncTicks = (uint64_t)(tsClock.ghz * TSCLOCK_RESYNC_NS);
+	tsClock.tsc0 = tscB;
+	tsClock.ns0 = nsB;
+	tsClock.useTsc = 1;
+	return 1;
+#else
+	tsClock.useTsc = 0;
+	tsClock.reason = "not x86";
+	return 0;
+#endif
+}
+
+/* Moves the reference point to now, with the rate measured since the
+ * previous one (follows the NTP corrections of CLOCK_MONOTONIC).
+ * Called by TsClock_Now_ns() when the reference is TSCLOCK_RESYNC_NS
+ * old; only one thread at a time does it, the others read
+ * clock_gettime() meanwhile. Returns the current time (ns) */
+int64_t TsClock_Resync(void)
+{
+#ifdef TSCLOCK_X86
+	uint64_t tsc = 0;
+	int64_t ns = 0;
+
+	if(__atomic_exchange_n(&tsClock.resyncing, 1, __ATOMIC_ACQUIRE))
+		return TsClock_Gettime_ns();
+	ReadPair(CLOCK_MONOTONIC, &tsc, &ns);
+
+	__atomic_store_n(&tsClock.seq, tsClock.seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if(tsc > tsClock.tsc0 && ns > tsClock.ns0)
+		__atomic_store_n(&tsClock.mult,
+			(uint64_t)(((unsigned __int128)(ns - tsClock.ns0) << TSCLOCK_SHIFT) / (tsc - tsClock.tsc0)), __ATOMIC_RELAXED);
+	__atomic_store_n(&tsClock.tsc0, tsc, __ATOMIC_RELAXED);
+	__atomic_store_n(&tsClock.ns0, ns, __ATOMIC_RELAXED);
+	__atomic_store_n(&tsClock.seq, tsClock.seq + 1, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&tsClock.resyncing, 0, __ATOMIC_RELEASE);
+	return ns;
+#else
+	return TsClock_Gettime_ns();
+#endif
+}
+
+/* Description of the source in use, for the startup banner */
+const char *TsClock_Source(void)
+{
+	static char desc[96];
+
+	if(tsClock.useTsc)
+		snprintf(desc, sizeof(desc), "invariant TSC (rdtscp, %.6f GHz)", tsClock.ghz);
+	else
+		snprintf(desc, sizeof(desc), "clock_gettime vDSO (%s)", tsClock.reason);
+	return desc;
+}
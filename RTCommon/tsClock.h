@@ -0,0 +1,103 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Low overhead timestamps
+ *
+ * TsClock_Now_ns() returns CLOCK_MONOTONIC time in ns. When the CPU
+ * has an invariant TSC (constant rate, not stopped in deep C-states)
+ * and the kernel also trusts it as clocksource, the time is computed
+ * from rdtscp, with the rate and the offset calibrated against
+ * CLOCK_MONOTONIC itself, so it stays on the timeline of the
+ * clock_nanosleep() absolute times. Otherwise (or before
+ * TsClock_Init()) it falls back to clock_gettime() (vDSO).
+ *
+ * NTP changes the rate of CLOCK_MONOTONIC (slewing, frequency
+ * correction), so the reference point is re-anchored, and the rate
+ * measured again over the last interval, every TSCLOCK_RESYNC_NS: by
+ * the first reader that finds the reference older than that (one
+ * ReadPair, about a microsecond). The reference is published with a
+ * sequence counter; a reader that finds it being updated uses
+ * clock_gettime() instead of waiting (no spinning on a preempted
+ * writer).
+ *
+ * Known issues and limitations:
+ *		- A re-anchor may step the time by the drift accumulated
+ *		  over one interval (a few ns), backwards included
+ *
+ *****************************************************************/
+
+#ifndef TS_CLOCK_H
+#define TS_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TSCLOCK_X86 1
+#endif
+
+#define TSCLOCK_CAL_NS (100*1000*1000)	// Calibration interval
+#define TSCLOCK_RESYNC_NS (1000*1000*1000)	// Re-anchor period
+#define TSCLOCK_SHIFT 32			// Fixed point of the tick -> ns factor
+
+struct tsClock {
+	int useTsc;				// 1: rdtscp, 0: clock_gettime
+	unsigned seq;			// Odd while the reference is being updated
+	uint64_t tsc0;			// TSC at the reference point...
+	int64_t ns0;			// ... and CLOCK_MONOTONIC at the same instant
+	uint64_t mult;			// ns per tick << TSCLOCK_SHIFT
+	uint64_t resyncTicks;	// TSCLOCK_RESYNC_NS in ticks
+	int resyncing;			// A reader is re-anchoring
+	double ghz;				// Calibrated TSC rate
+	const char *reason;		// Why the TSC is not used
+};
+
+extern struct tsClock tsClock;
+
+int TsClock_Init(int allowTsc);
+int64_t TsClock_Resync(void);
+const char *TsClock_Source(void);
+
+static inline int64_t TsClock_Gettime_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (int64_t)t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static inline int64_t TsClock_Now_ns(void)
+{
+#ifdef TSCLOCK_X86
+	if(tsClock.useTsc) {
+		unsigned int aux, seq;
+		uint64_t tsc0, mult, d;
+		int64_t ns0;
+
+		seq = __atomic_load_n(&tsClock.seq, __ATOMIC_ACQUIRE);
+		tsc0 = __atomic_load_n(&tsClock.tsc0, __ATOMIC_RELAXED);
+		ns0 = __atomic_load_n(&tsClock.ns0, __ATOMIC_RELAXED);
+		mult = __atomic_load_n(&tsClock.mult, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if((seq & 1) || seq != __atomic_load_n(&tsClock.seq, __ATOMIC_RELAXED))
+			return TsClock_Gettime_ns(); // Being re-anchored
+		d = __rdtscp(&aux) - tsc0;
+		if(d > tsClock.resyncTicks)
+			return TsClock_Resync();
+		return ns0 + (int64_t)(((unsigned __int128)d * mult) >> TSCLOCK_SHIFT);
+	}
+#endif
+	return TsClock_Gettime_ns();
+}
+
+/* Same, as a timespec (drop-in for clock_gettime(CLOCK_MONOTONIC, ts)) */
+static inline void TsClock_Gettime(struct timespec *ts)
+{
+	int64_t ns = TsClock_Now_ns();
+
+	ts->tv_sec = ns / 1000000000L;
+	ts->tv_nsec = ns % 1000000000L;
+}
+
+#endif
@@ -0,0 +1,294 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Measurement-based WCET estimation of Heavy_Work
+ *
+ * Usage: wcetBench [-n RUNS] [-s SUBINTERVAL | -C EXEC_US] [-i CPULIST]
+ *		[-F FLUSH_KB] [-p PRIORITY] [-b BLOCK] [-e PROB] [-k CONF_PCT]
+ *		[-t NAME -P PERIOD_US]
+ *		Runs the Heavy_Work kernel RUNS times (default 5000) on CPU 0
+ *		for each scenario and prints the execution time distribution
+ *		and the pWCET (see wcetEst.h) for an exceedance probability
+ *		PROB per job (default 1e-9), with its CONF_PCT % (default 95)
+ *		upper bound. The scenarios are:
+ *			warm	jobs back to back
+ *			cold	a buffer of FLUSH_KB (default: the LLC size, up
+ *				to 64 MB) is written before each job, evicting
+ *				the job's code and data from the caches
+ *		and, with -i, both again with a co-runner on each CPU of
+ *		CPULIST streaming writes over its own buffer (memory bus and
+ *		shared cache interference).
+ *
+ *		The load is SUBINTERVAL sub-intervals (default 200000, as
+ *		periodicTask) or, with -C, the sub-interval count that
+ *		LoadCal calibrates for EXEC_US (as periodicTask -C). With -p
+ *		the jobs run under SCHED_FIFO (co-runners stay SCHED_OTHER).
+ *
+ *		The largest bound of all scenarios is the C to use for the
+ *		task; with -t and -P, it is printed as a task line for
+ *		schedAnalyzer.
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "integKernel.h"
+#include "loadCal.h"
+#include "forkJoin.h"
+#include "hdrHist.h"
+#include "tsClock.h"
+#include "rtPrep.h"
+#include "wcetEst.h"
+
+#define WARMUP 10
+#define DEFAULT_SUBINTERVAL 200000
+#define MAX_FLUSH (64*1024*1024)	// Largest default cold cache buffer
+#define CORUNNER_BUF (64*1024*1024)	// Buffer streamed by each co-runner
+#define LINE 64
+
+struct scenario {
+	const char *name;
+	int cold;
+	int interference;
+};
+
+static const struct scenario scenarios[] = {
+	{ "warm", 0, 0 },
+	{ "cold", 1, 0 },
+	{ "warm+corun", 0, 1 },
+	{ "cold+corun", 1, 1 },
+	{ NULL, 0, 0 }
+};
+
+struct hdrHist exec_hist;
+uint64_t *samples;
+char *flush_buf;
+size_t flush_size;
+volatile int corun_stop;
+volatile double sink;		// Keeps the jobs from being optimized away
+
+/* Writes every cache line of the buffer */
+static void Flush(void)
+{
+	size_t i;
+
+	for(i = 0; i < flush_size; i += LINE)
+		flush_buf[i]++;
+}
+
+static void *Corunner_code(void *arg)
+{
+	char *buf = arg;
+	size_t i;
+
+	while(!corun_stop)
+		for(i = 0; i < CORUNNER_BUF && !corun_stop; i += LINE)
+			buf[i]++;
+	return NULL;
+}
+
+/* Starts one co-runner on each of the n CPUs. Returns how many started */
+static int Corunners_Start(const int *cpus, int n, pthread_t *threads, char **bufs)
+{
+	pthread_attr_t attr;
+	struct sched_param param = { .sched_priority = 0 };
+	cpu_set_t cpuset;
+	int i;
+
+	corun_stop = 0;
+	pthread_attr_init(&attr);
+	/* Not inherited: with -p main is already SCHED_FIFO */
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &param);
+	for(i = 0; i < n; i++) {
+		bufs[i] = malloc(CORUNNER_BUF);
+		if(bufs[i] == NULL)
+			break;
+		memset(bufs[i], 0, CORUNNER_BUF);
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpus[i], &cpuset);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+		if(pthread_create(&threads[i], &attr, Corunner_code, bufs[i])) {
+			free(bufs[i]);
+			break;
+		}
+	}
+	pthread_attr_destroy(&attr);
+	return i;
+}
+
+static void Corunners_Stop(int n, pthread_t *threads, char **bufs)
+{
+	int i;
+
+	corun_stop = 1;
+	for(i = 0; i < n; i++) {
+		pthread_join(threads[i], NULL);
+		free(bufs[i]);
+	}
+}
+
+/* Runs the scenario, leaving the execution times in samples[] */
+static void Measure(const struct scenario *sc, int subInterval, int runs)
+{
+	int64_t t0, t1;
+	int i;
+
+	HdrHist_Init(&exec_hist, HDR_DEFAULT_PRECISION_BITS);
+	for(i = 0; i < WARMUP + runs; i++) {
+		if(sc->cold)
+			Flush();
+		t0 = TsClock_Now_ns();
+		sink = Integ_Kernel(LOADCAL_LOWER, LOADCAL_UPPER, subInterval);
+		t1 = TsClock_Now_ns();
+		if(i >= WARMUP) {
+			samples[i - WARMUP] = t1 - t0;
+			HdrHist_Record(&exec_hist, t1 - t0);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int cpus[FJ_MAX_WORKERS], ncpus = 0, ncorun, prio = 0, runs = 5000, block = WCETEST_DEFAULT_BLOCK;
+	int subInterval = DEFAULT_SUBINTERVAL, opt, s, err, usage = 0;
+	double p = 1e-9, conf = 95, bound, worst = 0;
+	uint64_t exec_us = 0, period_us = 0;
+	const char *name = NULL, *worstName = NULL;
+	pthread_t threads[FJ_MAX_WORKERS];
+	char *bufs[FJ_MAX_WORKERS];
+	struct wcetFit fit;
+	struct loadCal lc;
+	struct sched_param parm;
+	cpu_set_t cpuset;
+	long llc;
+
+	while((opt = getopt(argc, argv, "n:s:C:i:F:p:b:e:k:t:P:")) != -1) {
+		switch(opt) {
+			case 'n':
+				runs = atoi(optarg);
+				break;
+			case 's':
+				subInterval = atoi(optarg);
+				break;
+			case 'C':
+				exec_us = strtoull(optarg, NULL, 10);
+				break;
+			case 'i':
+				ncpus = ForkJoin_ParseCpus(optarg, cpus, FJ_MAX_WORKERS);
+				break;
+			case 'F':
+				flush_size = (size_t)strtoull(optarg, NULL, 10) * 1024;
+				break;
+			case 'p':
+				prio = atoi(optarg);
+				break;
+			case 'b':
+				block = atoi(optarg);
+				break;
+			case 'e':
+				p = atof(optarg);
+				break;
+			case 'k':
+				conf = atof(optarg);
+				break;
+			case 't':
+				name = optarg;
+				break;
+			case 'P':
+				period_us = strtoull(optarg, NULL, 10);
+				break;
+			default:
+				usage = 1;
+				break;
+		}
+	}
+	if(usage || optind != argc || runs < 1 || subInterval < 2 || ncpus < 0 || block < 1
+		|| p <= 0 || p >= 1 || conf <= 0 || conf >= 100) {
+		printf("Usage: %s [-n RUNS] [-s SUBINTERVAL | -C EXEC_US] [-i CPULIST] [-F FLUSH_KB]\n"
+			"\t[-p PRIORITY] [-b BLOCK] [-e PROB] [-k CONF_PCT] [-t NAME -P PERIOD_US]\n", argv[0]);
+		return 1;
+	}
+	if(runs / block < WCETEST_MIN_BLOCKS)
+		printf("Warning: %d runs make less than %d blocks of %d, no pWCET\n", runs, WCETEST_MIN_BLOCKS, block);
+
+	err = RtPrep_Process(RTPREP_HEAP_RESERVE);
+	if(err)
+		printf("Warning: could not lock memory (%s), page faults may inflate the times\n", strerror(-err));
+	CPU_ZERO(&cpuset);
+	CPU_SET(0, &cpuset);
+	sched_setaffinity(0, sizeof(cpuset), &cpuset);
+	if(prio > 0) {
+		parm.sched_priority = prio;
+		if(sched_setscheduler(0, SCHED_FIFO, &parm))
+			perror("sched_setscheduler (running as SCHED_OTHER)");
+	}
+
+	IntegKernel_Select();
+	TsClock_Init(1);
+	if(exec_us) {
+		LoadCal_Init(&lc, exec_us * 1000, subInterval);
+		subInterval = lc.subInterval;
+	}
+	if(flush_size == 0) {
+		llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+		if(llc <= 0)
+			llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+		flush_size = llc > 0 && llc < MAX_FLUSH ? (size_t)llc : MAX_FLUSH;
+	}
+	samples = malloc(runs * sizeof(*samples));
+	flush_buf = calloc(1, flush_size);
+	if(samples == NULL || flush_buf == NULL) {
+		printf("Out of memory\n");
+		return 1;
+	}
+
+	printf("Kernel %s, subInterval=%d, %d runs per scenario, timestamps from %s, flush %zu KB\n",
+		IntegKernel_Select(), subInterval, runs, TsClock_Source(), flush_size / 1024);
+	printf("%-11s %10s %10s %10s %10s %10s %12s %12s %5s\n", "scenario", "min(us)", "p50(us)", "p99(us)",
+		"p99.9(us)", "max(us)", "pWCET(us)", "bound(us)", "fit");
+
+	for(s = 0; scenarios[s].name != NULL; s++) {
+		if(scenarios[s].interference && ncpus == 0)
+			continue;
+		ncorun = scenarios[s].interference ? Corunners_Start(cpus, ncpus, threads, bufs) : 0;
+		Measure(&scenarios[s], subInterval, runs);
+		if(scenarios[s].interference)
+			Corunners_Stop(ncorun, threads, bufs);
+
+		printf("%-11s %10.3f %10.3f %10.3f %10.3f %10.3f", scenarios[s].name,
+			(double)exec_hist.min / 1000, (double)HdrHist_Percentile(&exec_hist, 50.0) / 1000,
+			(double)HdrHist_Percentile(&exec_hist, 99.0) / 1000,
+			(double)HdrHist_Percentile(&exec_hist, 99.9) / 1000, (double)exec_hist.max / 1000);
+		if(WcetEst_Fit(samples, runs, block, &fit)) {
+			printf(" %12s %12s\n", "-", "-");
+			bound = exec_hist.max; // No fit: the largest observation is all there is
+		}
+		else {
+			bound = WcetEst_Bound(samples, runs, block, p, conf / 100);
+			printf(" %12.3f %12.3f %5s\n", WcetEst_Pwcet(&fit, p) / 1000, bound / 1000,
+				fit.ks <= fit.ksCritical ? "ok" : "POOR");
+		}
+		if(scenarios[s].interference && ncorun < ncpus)
+			printf("  (only %d of %d co-runners started)\n", ncorun, ncpus);
+		if(bound > worst) {
+			worst = bound;
+			worstName = scenarios[s].name;
+		}
+	}
+
+	printf("pWCET at %.0e per job, %.0f%% upper bound; fit: KS test of the Gumbel fit of block maxima\n", p, conf);
+	printf("WCET estimate (worst scenario, %s): C = %.0f us\n", worstName, ceil(worst / 1000));
+	if(name != NULL && period_us)
+		printf("Task line for schedAnalyzer:\n%s %.0f %llu\n", name, ceil(worst / 1000),
+			(unsigned long long)period_us);
+	return 0;
+}
@@ -0,0 +1,181 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Probabilistic WCET estimation (extreme value theory) - implementation
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "wcetEst.h"
+
+#define MAX_ITER 100		// Newton iterations of the fit
+
+static int CmpDouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Maximum likelihood Gumbel fit of y[0..m-1] (only mu and beta are set).
+ * The data is standardized first, so the exponentials stay in range */
+static void FitMaxima(const double *y, int m, struct wcetFit *fit)
+{
+	double c = 0, s = 0, b, db, z, w, S0, S1, S2;
+	int i, it;
+
+	for(i = 0; i < m; i++)
+		c += y[i];
+	c /= m;
+	for(i = 0; i < m; i++)
+		s += (y[i] - c) * (y[i] - c);
+	s = sqrt(s / m);
+	if(s == 0) { // Every block had the same maximum
+		fit->mu = c;
+		fit->beta = 0;
+		return;
+	}
+
+	/* Newton on b - mean(z) + sum(z e^(-z/b)) / sum(e^(-z/b)) = 0, with
+	 * mean(z) = 0, from the method of moments estimate */
+	b = sqrt(6) / M_PI;
+	for(it = 0; it < MAX_ITER; it++) {
+		S0 = S1 = S2 = 0;
+		for(i = 0; i < m; i++) {
+			z = (y[i] - c) / s;
+			w = exp(-z / b);
+			S0 += w;
+			S1 += z * w;
+			S2 += z * z * w;
+		}
+		db = (b + S1 / S0) / (1 + (S2 * S0 - S1 * S1) / (b * b * S0 * S0));
+		b = b - db > 0 ? b - db : b / 2;
+		if(fabs(db) < 1e-10)
+			break;
+	}
+	for(i = 0, S0 = 0; i < m; i++)
+		S0 += exp(-(y[i] - c) / s / b);
+	fit->mu = c + s * (-b * log(S0 / m));
+	fit->beta = s * b;
+}
+
+static double Quantile(const struct wcetFit *fit, double p)
+{
+	double pBlock = -expm1(fit->block * log1p(-p)); // 1-(1-p)^block
+
+	return fit->mu - fit->beta * log(-log1p(-pBlock));
+}
+
+/* Maxima of the blocks of "block" samples, in a new array (NULL on error) */
+static double *BlockMaxima(const uint64_t *samples, int n, int block, int *m)
+{
+	double *y;
+	int i, k;
+
+	*m = block > 0 ? n / block : 0;
+	if(*m < WCETEST_MIN_BLOCKS)
+		return NULL;
+	y = malloc(*m * sizeof(*y));
+	if(y == NULL)
+		return NULL;
+	for(k = 0; k < *m; k++) {
+		y[k] = 0;
+		for(i = k * block; i < (k + 1) * block; i++)
+			if(samples[i] > y[k])
+				y[k] = samples[i];
+	}
+	return y;
+}
+
+/* Fits the maxima of the blocks of "samples". Returns 0, or -EINVAL if
+ * there are less than WCETEST_MIN_BLOCKS blocks (or -ENOMEM) */
+int WcetEst_Fit(const uint64_t *samples, int n, int block, struct wcetFit *fit)
+{
+	double *y, F, d;
+	int i, m;
+
+	y = BlockMaxima(samples, n, block, &m);
+	if(y == NULL)
+		return m < WCETEST_MIN_BLOCKS ? -EINVAL : -ENOMEM;
+
+	memset(fit, 0, sizeof(*fit));
+	fit->block = block;
+	fit->blocks = m;
+	for(i = 0; i < n; i++)
+		if(samples[i] > fit->maxObserved)
+			fit->maxObserved = samples[i];
+	FitMaxima(y, m, fit);
+
+	/* Kolmogorov-Smirnov distance between the fit and the empirical
+	 * distribution of the maxima */
+	qsort(y, m, sizeof(*y), CmpDouble);
+	for(i = 0; i < m; i++) {
+		F = fit->beta > 0 ? exp(-exp(-(y[i] - fit->mu) / fit->beta)) : (y[i] >= fit->mu);
+		d = fmax(F - (double)i / m, (double)(i + 1) / m - F);
+		if(d > fit->ks)
+			fit->ks = d;
+	}
+	fit->ksCritical = 1.36 / sqrt(m);
+	free(y);
+	return 0;
+}
+
+/* Execution time exceeded with probability p per job, according to the fit */
+double WcetEst_Pwcet(const struct wcetFit *fit, double p)
+{
+	return Quantile(fit, p);
+}
+
+/* Upper bound of the pWCET (probability p per job) at the given
+ * confidence (e.g. 0.95), by bootstrap. Returns -1 on error */
+double WcetEst_Bound(const uint64_t *samples, int n, int block, double p, double confidence)
+{
+	double *y, *r, *q, bound;
+	struct wcetFit fit = { .block = block };
+	uint64_t x = 0x9e3779b97f4a7c15ULL; // xorshift64 state, fixed: reproducible bounds
+	int m, i, k;
+
+	y = BlockMaxima(samples, n, block, &m);
+	if(y == NULL)
+		return -1;
+	r = malloc(m * sizeof(*r));
+	q = malloc(WCETEST_RESAMPLES * sizeof(*q));
+	if(r == NULL || q == NULL) {
+		free(y);
+		free(r);
+		free(q);
+		return -1;
+	}
+
+	for(k = 0; k < WCETEST_RESAMPLES; k++) {
+		for(i = 0; i < m; i++) {
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			r[i] = y[x % m];
+		}
+		FitMaxima(r, m, &fit);
+		q[k] = Quantile(&fit, p);
+	}
+	qsort(q, WCETEST_RESAMPLES, sizeof(*q), CmpDouble);
+	k = (int)ceil(confidence * WCETEST_RESAMPLES) - 1;
+	bound = q[k < 0 ? 0 : k >= WCETEST_RESAMPLES ? WCETEST_RESAMPLES - 1 : k];
+
+	free(y);
+	free(r);
+	free(q);
+	return bound;
+}
+
+void WcetEst_Print(const struct wcetFit *fit, double p, double bound, const char *name, FILE *out)
+{
+	fprintf(out, "%s: Gumbel fit of %d maxima of %d jobs, mu %.3f us, beta %.3f us, KS %.3f (%s)\n",
+		name, fit->blocks, fit->block, fit->mu / 1000, fit->beta / 1000, fit->ks,
+		fit->ks <= fit->ksCritical ? "good fit" : "POOR FIT, check the conditions are stable");
+	fprintf(out, "%s: max observed %.3f us, pWCET(%.0e) %.3f us, upper bound %.3f us\n",
+		name, (double)fit->maxObserved / 1000, p, WcetEst_Pwcet(fit, p) / 1000, bound / 1000);
+}
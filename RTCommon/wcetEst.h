@@ -0,0 +1,48 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Probabilistic WCET estimation (extreme value theory)
+ *
+ * The execution times measured for a job are split in blocks of
+ * "block" consecutive samples and a Gumbel distribution is fitted
+ * (maximum likelihood) to the maxima of the blocks. The pWCET for an
+ * exceedance probability p per job is the quantile of that fit for
+ * a block exceedance of 1-(1-p)^block. WcetEst_Bound() gives an
+ * upper confidence bound of the pWCET by bootstrap (resampling the
+ * block maxima with replacement and refitting).
+ *
+ * The fit is only meaningful if the samples are independent and
+ * identically distributed (same conditions for every job) and there
+ * are at least WCETEST_MIN_BLOCKS blocks. The Kolmogorov-Smirnov
+ * distance between the fit and the block maxima is reported to
+ * judge it.
+ *
+ * All times in ns.
+ *
+ *****************************************************************/
+
+#ifndef WCET_EST_H
+#define WCET_EST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define WCETEST_MIN_BLOCKS 20		// Fewer block maxima are not fitted
+#define WCETEST_DEFAULT_BLOCK 50	// Samples per block
+#define WCETEST_RESAMPLES 1000		// Bootstrap resamples of WcetEst_Bound()
+
+struct wcetFit {
+	int block;			// Samples per block
+	int blocks;			// Block maxima fitted
+	double mu, beta;		// Gumbel location and scale (ns)
+	double ks;			// Kolmogorov-Smirnov distance fit/block maxima
+	double ksCritical;		// 5% critical value of ks (larger: poor fit)
+	uint64_t maxObserved;		// Largest sample
+};
+
+int WcetEst_Fit(const uint64_t *samples, int n, int block, struct wcetFit *fit);
+double WcetEst_Pwcet(const struct wcetFit *fit, double p);
+double WcetEst_Bound(const uint64_t *samples, int n, int block, double p, double confidence);
+void WcetEst_Print(const struct wcetFit *fit, double p, double bound, const char *name, FILE *out);
+
+#endif
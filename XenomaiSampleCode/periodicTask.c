@@ -9,8 +9,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <sched.h>
 #include <signal.h>
 #include <math.h>
+#include <errno.h>
 
 #include <sys/mman.h> // For mlockall
 
@@ -18,6 +21,16 @@
 #include <alchemy/task.h>
 #include <alchemy/timer.h>
 
+#include "hdrHist.h"
+#include "rtLog.h"
+#include "actTrace.h"
+#include "integKernel.h"
+#include "loadCal.h"
+#include "taskStats.h"
+#include "overrun.h"
+#include "cpuTopo.h"
+#include "schedAnalysis.h"
+
 #define MS_2_NS(ms)(ms*1000*1000) /* Convert ms to ns */
 
 /* *****************************************************
@@ -26,6 +39,11 @@
  struct taskArgsStruct {
 	 RTIME taskPeriod_ns;
 	 int some_other_arg;
+	 struct hdrHist *jitterHist;	// Inter-arrival jitter distribution
+	 struct rtLog *log;				// Deferred output (printf would switch to secondary mode)
+	 struct actTrace *trace;		// Activation trace (-T option)
+	 struct taskStats *stats;		// Release latency, execution/response times, deadline misses
+	 struct overrunCtl *ovr;		// Overrun policy and counters
  };
 
 /* *******************
@@ -45,6 +63,39 @@ RT_TASK task_a_desc; // Task decriptor
 RT_TASK task_b_desc; // Task decriptor
 RT_TASK task_c_desc; // Task decriptor
 
+#define HIST_PRECISION_BITS HDR_DEFAULT_PRECISION_BITS	// Resolution of the latency histograms
+
+#define DEFAULT_SUBINTERVAL 1000000	// Heavy_Work load when no execution time is given (-C)
+
+struct hdrHist task_a_hist; // Inter-arrival jitter histograms
+struct hdrHist task_b_hist;
+struct hdrHist task_c_hist;
+
+struct rtLog task_a_log; // Per task log rings, drained by the logger thread
+struct rtLog task_b_log;
+struct rtLog task_c_log;
+
+struct actTrace task_a_trace; // Activation traces (only used with -T)
+struct actTrace task_b_trace;
+struct actTrace task_c_trace;
+
+struct loadCal task_a_load; // Heavy_Work load of each task (-C option)
+struct loadCal task_b_load;
+struct loadCal task_c_load;
+
+struct taskStats task_a_stats; // Per activation accounting of each task
+struct taskStats task_b_stats;
+struct taskStats task_c_stats;
+
+struct overrunCtl task_a_ovr; // Overrun handling of each task (-O option)
+struct overrunCtl task_b_ovr;
+struct overrunCtl task_c_ovr;
+
+struct cpuTopo topo; // CPU topology, for the placement
+cpu_set_t task_cpus[3]; // CPUs of tasks a, b and c (-A option, or picked from the topology)
+struct saTask part_tasks[3]; // Partitioned mode (-P option): tasks a, b and c ...
+int part_cpus[SA_MAX_TASKS], part_ncpus = 0; // ... and the CPU of each core
+
 
 
 
@@ -52,6 +103,10 @@ RT_TASK task_c_desc; // Task decriptor
 * Function prototypes
 * **********************/
 void catch_signal(int sig); 	/* Catches CTRL + C to allow a controlled termination of the application */
+int parse_us_list(char *s, uint64_t ns[3]);	/* Per task option values */
+int parse_cpu_lists(char *s, cpu_set_t cpus[3]);	/* Per task CPU sets */
+int partition(uint64_t exec_ns[3], uint64_t deadline_ns[3], enum saFit fit);	/* Partitioned mode */
+void print_partition(void);
 void wait_for_ctrl_c(void);
 void Heavy_Work(void);      	/* Load task */
 void task_code(void *args); 	/* Task body */
@@ -66,14 +121,108 @@ void Heavy_Work_C(); 	/* Task body */
 * Main function
 * *******************/ 
 int main(int argc, char *argv[]) {
-	int err; 
+	int err, opt; 
+	char *traceprefix = NULL;
+	char tracefile[256];
+	uint64_t exec_ns[3] = { 0, 0, 0 };
+	uint64_t deadline_ns[3] = { 0, 0, 0 };
+	int policy = OVERRUN_SKIP;
+	int placed = 0;
+	enum saFit fit = SA_WORST_FIT;
+	cpu_set_t partset;
+	char cpulist[256];
+	cpu_set_t cpuset;
 	struct taskArgsStruct taskAArgs;
 	struct taskArgsStruct taskBArgs;
 	struct taskArgsStruct taskCArgs;
 	
+	/* Process options */
+	while((opt = getopt(argc, argv, "T:C:D:O:A:P:F:")) != -1) {
+		switch(opt) {
+			case 'T':	// Activation traces, written to PREFIX_a.trace, PREFIX_b.trace, ...
+				traceprefix = optarg;
+				break;
+			case 'C':	// Heavy_Work execution time (us) of tasks a, b and c
+				if(parse_us_list(optarg, exec_ns))
+					break;
+				printf("Invalid execution time list %s\n", optarg);
+				return -1;
+			case 'D':	// Relative deadline (us) of tasks a, b and c (default: period)
+				if(parse_us_list(optarg, deadline_ns))
+					break;
+				printf("Invalid deadline list %s\n", optarg);
+				return -1;
+			case 'A':	// CPUs of tasks a, b and c
+				placed = parse_cpu_lists(optarg, task_cpus);
+				if(placed)
+					break;
+				printf("Invalid CPU list %s\n", optarg);
+				return -1;
+			case 'P':	// Partitioned mode, over these CPUs (one core each)
+				if(CpuTopo_ParseList(optarg, &partset) <= 0) {
+					printf("Invalid CPU list %s\n", optarg);
+					return -1;
+				}
+				for(int cpu = 0; cpu < CPU_SETSIZE && part_ncpus < SA_MAX_TASKS; cpu++)
+					if(CPU_ISSET(cpu, &partset))
+						part_cpus[part_ncpus++] = cpu;
+				break;
+			case 'O':	// Overrun policy of the three tasks
+				policy = Overrun_Parse(optarg);
+				if(policy >= 0)
+					break;
+				printf("Invalid overrun policy %s\n", optarg);
+				return -1;
+			case 'F':	// Bin-packing heuristic of the partitioned mode
+				if(!strcmp(optarg, "wf") || !strcmp(optarg, "ff")) {
+					fit = strcmp(optarg, "ff") ? SA_WORST_FIT : SA_FIRST_FIT;
+					break;
+				}
+				/* fall through: usage */
+			default:
+				printf("Usage: %s [-T TRACEPREFIX] [-C A_US[,B_US,C_US]] [-D A_US[,B_US,C_US]] [-O catchup|skip|abort] [-A A_CPUS[:B_CPUS:C_CPUS] | -P CPULIST [-F wf|ff]]\n", argv[0]);
+				return -1;
+		}
+	}
+
+	/* Placement: the tasks on the CPUs given, partitioned over the CPUs
+	 * given or, as one uniprocessor task set, on the CPU picked from the
+	 * topology; the rest of the process (main, logger) on the others */
+	CpuTopo_Read(&topo);
+	if(part_ncpus) {
+		if(partition(exec_ns, deadline_ns, fit))
+			return -1;
+	} else if(!placed) {
+		CpuTopo_Pick(&topo, &task_cpus[0]);
+		task_cpus[1] = task_cpus[2] = task_cpus[0];
+	}
+	CpuTopo_Print(&topo, stdout);
+	for(int i = 0; i < 3; i++)
+		CpuTopo_Assign(&topo, &task_cpus[i]);
+	CpuTopo_Housekeeping(&topo, &cpuset);
+	if(sched_setaffinity(0, sizeof(cpuset), &cpuset))
+		printf("Warning: could not move main to the housekeeping CPUs (error code = %d)\n", -errno);
+	else
+		printf("Placement: main and logger on CPU %s\n", CpuTopo_ListStr(&cpuset, cpulist, sizeof(cpulist)));
+
 	/* Lock memory to prevent paging */
 	mlockall(MCL_CURRENT|MCL_FUTURE); 
 
+	printf("Heavy_Work integration kernel: %s\n", IntegKernel_Select());
+
+	/* Calibrate the load of each task (after mlockall, before the RT tasks start) */
+	struct loadCal *loads[] = { &task_a_load, &task_b_load, &task_c_load };
+	for(int i = 0; i < 3; i++) {
+		err = LoadCal_Init(loads[i], exec_ns[i], DEFAULT_SUBINTERVAL);
+		if(err) {
+			printf("Error calibrating load of task %c (error code = %d)\n", 'a' + i, err);
+			return err;
+		}
+		if(exec_ns[i])
+			printf("Task %c Heavy_Work calibrated: %d sub-intervals for %.3f us\n",
+				'a' + i, loads[i]->subInterval, (double)exec_ns[i] / 1000);
+	}
+
 	/* Create RT task */
 	/* Args: descriptor, name, stack size, priority [0..99] and mode (flags for CPU, FPU, joinable ...) */
 	err=rt_task_create(&task_a_desc, "Task a", TASK_STKSZ, TASK_A_PRIO, TASK_MODE);
@@ -97,41 +246,100 @@ int main(int argc, char *argv[]) {
 	} else 
 		printf("Task c created successfully\n");
 	
-	int ret1,ret2,ret3;
-	cpu_set_t cpuset;
-	CPU_ZERO(&cpuset);
-	CPU_SET(0, &cpuset);
-	ret1 = rt_task_set_affinity(&task_a_desc, &cpuset);
-	if (ret1) {
-		printf("Error setting affinity for task a (error code = %d)\n",ret1);
-		return ret1;
+	RT_TASK *descs[] = { &task_a_desc, &task_b_desc, &task_c_desc };
+	const char *taskNames[] = { "Task a", "Task b", "Task c" };
+	for(int i = 0; i < 3; i++) {
+		err = rt_task_set_affinity(descs[i], &task_cpus[i]);
+		if(err) {
+			printf("Error setting affinity for task %c (error code = %d)\n", 'a' + i, err);
+			return err;
+		}
+		CpuTopo_Check(&topo, &task_cpus[i], taskNames[i], stdout);
 	}
-
-	ret2 = rt_task_set_affinity(&task_b_desc, &cpuset);
-	if (ret2) {
-		printf("Error setting affinity for task b (error code = %d)\n",ret2);
-		return ret2;
+			
+	HdrHist_Init(&task_a_hist, HIST_PRECISION_BITS);
+	HdrHist_Init(&task_b_hist, HIST_PRECISION_BITS);
+	HdrHist_Init(&task_c_hist, HIST_PRECISION_BITS);
+	TaskStats_Init(&task_a_stats, deadline_ns[0] ? deadline_ns[0] : TASK_A_PERIOD_NS);
+	TaskStats_Init(&task_b_stats, deadline_ns[1] ? deadline_ns[1] : TASK_A_PERIOD_NS);
+	TaskStats_Init(&task_c_stats, deadline_ns[2] ? deadline_ns[2] : TASK_A_PERIOD_NS);
+	Overrun_Init(&task_a_ovr, policy, TASK_A_PERIOD_NS, task_a_stats.deadline_ns);
+	Overrun_Init(&task_b_ovr, policy, TASK_A_PERIOD_NS, task_b_stats.deadline_ns);
+	Overrun_Init(&task_c_ovr, policy, TASK_A_PERIOD_NS, task_c_stats.deadline_ns);
+
+	/* Preallocate and map the trace files, if requested */
+	if(traceprefix != NULL) {
+		struct actTrace *traces[] = { &task_a_trace, &task_b_trace, &task_c_trace };
+		const char *names[] = { "Task a", "Task b", "Task c" };
+		for(int i = 0; i < 3; i++) {
+			snprintf(tracefile, sizeof(tracefile), "%s_%c.trace", traceprefix, 'a' + i);
+			err = ActTrace_Open(traces[i], tracefile, names[i], TASK_A_PERIOD_NS, 0);
+			if(err) {
+				printf("Error creating trace file %s (error code = %d)\n", tracefile, err);
+				return err;
+			}
+		}
 	}
 
-	ret3 = rt_task_set_affinity(&task_c_desc, &cpuset);
-	if (ret3) {
-		printf("Error setting affinity for task 3c(error code = %d)\n",ret3);
-		return ret3;
+	/* Start the (non RT) logger thread */
+	RtLog_Init(&task_a_log, "Task a");
+	RtLog_Init(&task_b_log, "Task b");
+	RtLog_Init(&task_c_log, "Task c");
+	struct rtLog *logs[] = { &task_a_log, &task_b_log, &task_c_log };
+	err = RtLogger_Start(logs, 3, stdout);
+	if(err) {
+		printf("Error creating logger thread (error code = %d)\n",err);
+		return err;
 	}
 			
 	/* Start RT task */
 	/* Args: task decriptor, address of function/implementation and argument*/
 	taskAArgs.taskPeriod_ns = TASK_A_PERIOD_NS; 	
+	taskAArgs.jitterHist = &task_a_hist;
+	taskAArgs.log = &task_a_log;
+	taskAArgs.trace = &task_a_trace;
+	taskAArgs.stats = &task_a_stats;
+	taskAArgs.ovr = &task_a_ovr;
     rt_task_start(&task_a_desc, &task_code, (void *)&taskAArgs);
 
 	taskBArgs.taskPeriod_ns = TASK_A_PERIOD_NS; 	
+	taskBArgs.jitterHist = &task_b_hist;
+	taskBArgs.log = &task_b_log;
+	taskBArgs.trace = &task_b_trace;
+	taskBArgs.stats = &task_b_stats;
+	taskBArgs.ovr = &task_b_ovr;
     rt_task_start(&task_b_desc, &task_code_B, (void *)&taskBArgs);
 
 	taskCArgs.taskPeriod_ns = TASK_A_PERIOD_NS; 	
+	taskCArgs.jitterHist = &task_c_hist;
+	taskCArgs.log = &task_c_log;
+	taskCArgs.trace = &task_c_trace;
+	taskCArgs.stats = &task_c_stats;
+	taskCArgs.ovr = &task_c_ovr;
     rt_task_start(&task_c_desc, &task_code_C, (void *)&taskCArgs);
     
 	/* wait for termination signal */	
 	wait_for_ctrl_c();
+	RtLogger_Stop();
+	ActTrace_Close(&task_a_trace);
+	ActTrace_Close(&task_b_trace);
+	ActTrace_Close(&task_c_trace);
+
+	/* Show the jitter distribution of each task */
+	HdrHist_Print(&task_a_hist, "Task a inter-arrival jitter", stdout);
+	HdrHist_Print(&task_b_hist, "Task b inter-arrival jitter", stdout);
+	HdrHist_Print(&task_c_hist, "Task c inter-arrival jitter", stdout);
+	TaskStats_Print(&task_a_stats, "Task a", stdout);
+	TaskStats_Print(&task_b_stats, "Task b", stdout);
+	TaskStats_Print(&task_c_stats, "Task c", stdout);
+	Overrun_Print(&task_a_ovr, "Task a", stdout);
+	Overrun_Print(&task_b_ovr, "Task b", stdout);
+	Overrun_Print(&task_c_ovr, "Task c", stdout);
+	LoadCal_Print(&task_a_load, "Task a", stdout);
+	LoadCal_Print(&task_b_load, "Task b", stdout);
+	LoadCal_Print(&task_c_load, "Task c", stdout);
+	if(part_ncpus)
+		print_partition();
 
 	return 0;
 		
@@ -146,7 +354,11 @@ void task_code(void *args) {
 	struct taskArgsStruct *taskArgs;
 
 	RTIME ta=0;
+	RTIME release; // Expected release of the current activation
+	RTIME tws=0;   // Work start
+	RTIME twe;     // Work end
 	unsigned long overruns;
+	unsigned long job, jobs; // Jobs served in this activation (more than one when catching up)
 	int err;
 
 	RTIME ta_anterior=0;
@@ -158,18 +370,21 @@ void task_code(void *args) {
 	curtask=rt_task_self();
 	rt_task_inquire(curtask,&curtaskinfo);
 	taskArgs=(struct taskArgsStruct *)args;
-	printf("Task %s init, period:%llu\n", curtaskinfo.name, taskArgs->taskPeriod_ns);
+	RtLog_Printf(taskArgs->log, "Task %s init, period:%llu\n", curtaskinfo.name, taskArgs->taskPeriod_ns);
 		
-	/* Set task as periodic */
-	err=rt_task_set_periodic(NULL, TM_NOW, taskArgs->taskPeriod_ns);
+	/* Set task as periodic, first release one period from now */
+	release=rt_timer_read();
+	err=rt_task_set_periodic(NULL, release + taskArgs->taskPeriod_ns, taskArgs->taskPeriod_ns);
 	for(;;) {
+		overruns=0;
 		err=rt_task_wait_period(&overruns);
 		ta=rt_timer_read();
-		if(err) {
-			printf("task %s overrun!!!\n", curtaskinfo.name);
+		release+=(overruns + 1) * taskArgs->taskPeriod_ns;
+		if(err && err != -ETIMEDOUT) { // -ETIMEDOUT: overrun, handled below
+			RtLog_Printf(taskArgs->log, "task %s wait period error %d!!!\n", curtaskinfo.name, err);
 			break;
 		}
-		printf("\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
+		RtLog_Printf(taskArgs->log, "\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
 
 
 		if (ta_anterior == 0){
@@ -184,19 +399,35 @@ void task_code(void *args) {
 			if (ta - ta_anterior > tempo_maximo){
 				tempo_maximo = ta - ta_anterior;
 			}
+			HdrHist_Record(taskArgs->jitterHist, llabs((SRTIME)(ta - ta_anterior) - (SRTIME)taskArgs->taskPeriod_ns));
 			show =1;
 		}
 
 		ta_anterior = ta;
 		
 		if (show== 1){
-			printf("Task %s Tempo Minimo: %llu / Tempo Maximo: %llu\n\r",curtaskinfo.name, tempo_minimo, tempo_maximo);
+			RtLog_Printf(taskArgs->log, "Task %s Tempo Minimo: %llu / Tempo Maximo: %llu\n\r",curtaskinfo.name, tempo_minimo, tempo_maximo);
 		}
 			
 		
 		
 		/* Task "load" */
-		Heavy_Work();
+		/* Overrun handling: abort the job or serve the missed releases (see overrun.h) */
+		if(!Overrun_Check(taskArgs->ovr, overruns, ta - release))
+			continue;
+		jobs = taskArgs->ovr->policy == OVERRUN_CATCHUP ? overruns + 1 : 1;
+		for(job = jobs; job > 0; job--) {
+			RTIME jr = release - (job - 1) * taskArgs->taskPeriod_ns; // Release of this job
+			tws=rt_timer_read();
+			Heavy_Work();
+			twe=rt_timer_read();
+			
+			/* Job accounting: release latency, execution and response times, deadline */
+			if(TaskStats_Record(taskArgs->stats, jr, ta, tws, twe))
+				ActTrace_Record(taskArgs->trace, jr, ta, tws, twe, (overruns ? ACT_TRACE_F_OVERRUN : 0) | ACT_TRACE_F_DEADLINE_MISS);
+			else
+				ActTrace_Record(taskArgs->trace, jr, ta, tws, twe, overruns ? ACT_TRACE_F_OVERRUN : 0);
+		}
 		
 	}
 	return;
@@ -208,7 +439,11 @@ void task_code_B(void *args) {
 	struct taskArgsStruct *taskArgs;
 
 	RTIME ta=0;
+	RTIME release; // Expected release of the current activation
+	RTIME tws=0;   // Work start
+	RTIME twe;     // Work end
 	unsigned long overruns;
+	unsigned long job, jobs; // Jobs served in this activation (more than one when catching up)
 	int err;
 
 
@@ -221,18 +456,21 @@ void task_code_B(void *args) {
 	curtask=rt_task_self();
 	rt_task_inquire(curtask,&curtaskinfo);
 	taskArgs=(struct taskArgsStruct *)args;
-	printf("Task %s init, period:%llu\n", curtaskinfo.name, taskArgs->taskPeriod_ns);
+	RtLog_Printf(taskArgs->log, "Task %s init, period:%llu\n", curtaskinfo.name, taskArgs->taskPeriod_ns);
 		
-	/* Set task as periodic */
-	err=rt_task_set_periodic(NULL, TM_NOW, taskArgs->taskPeriod_ns);
+	/* Set task as periodic, first release one period from now */
+	release=rt_timer_read();
+	err=rt_task_set_periodic(NULL, release + taskArgs->taskPeriod_ns, taskArgs->taskPeriod_ns);
 	for(;;) {
+		overruns=0;
 		err=rt_task_wait_period(&overruns);
 		ta=rt_timer_read();
-		if(err) {
-			printf("task %s overrun!!!\n", curtaskinfo.name);
+		release+=(overruns + 1) * taskArgs->taskPeriod_ns;
+		if(err && err != -ETIMEDOUT) { // -ETIMEDOUT: overrun, handled below
+			RtLog_Printf(taskArgs->log, "task %s wait period error %d!!!\n", curtaskinfo.name, err);
 			break;
 		}
-		printf("\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
+		RtLog_Printf(taskArgs->log, "\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
 
 
 		if (ta_anterior == 0){
@@ -247,17 +485,33 @@ void task_code_B(void *args) {
 			if (ta - ta_anterior > tempo_maximo){
 				tempo_maximo = ta - ta_anterior;
 			}
+			HdrHist_Record(taskArgs->jitterHist, llabs((SRTIME)(ta - ta_anterior) - (SRTIME)taskArgs->taskPeriod_ns));
 			show =1;
 		}
 
 		ta_anterior = ta;
 		
 		if (show== 1){
-			printf("Task %s Tempo Minimo: %llu / Tempo Maximo: %llu\n\r",curtaskinfo.name, tempo_minimo, tempo_maximo);
+			RtLog_Printf(taskArgs->log, "Task %s Tempo Minimo: %llu / Tempo Maximo: %llu\n\r",curtaskinfo.name, tempo_minimo, tempo_maximo);
 		}
 		
 		/* Task "load" */
-		Heavy_Work_B();
+		/* Overrun handling: abort the job or serve the missed releases (see overrun.h) */
+		if(!Overrun_Check(taskArgs->ovr, overruns, ta - release))
+			continue;
+		jobs = taskArgs->ovr->policy == OVERRUN_CATCHUP ? overruns + 1 : 1;
+		for(job = jobs; job > 0; job--) {
+			RTIME jr = release - (job - 1) * taskArgs->taskPeriod_ns; // Release of this job
+			tws=rt_timer_read();
+			Heavy_Work_B();
+			twe=rt_timer_read();
+			
+			/* Job accounting: release latency, execution and response times, deadline */
+			if(TaskStats_Record(taskArgs->stats, jr, ta, tws, twe))
+				ActTrace_Record(taskArgs->trace, jr, ta, tws, twe, (overruns ? ACT_TRACE_F_OVERRUN : 0) | ACT_TRACE_F_DEADLINE_MISS);
+			else
+				ActTrace_Record(taskArgs->trace, jr, ta, tws, twe, overruns ? ACT_TRACE_F_OVERRUN : 0);
+		}
 		
 	}
 	return;
@@ -269,7 +523,11 @@ void task_code_C(void *args) {
 	struct taskArgsStruct *taskArgs;
 
 	RTIME ta=0;
+	RTIME release; // Expected release of the current activation
+	RTIME tws=0;   // Work start
+	RTIME twe;     // Work end
 	unsigned long overruns;
+	unsigned long job, jobs; // Jobs served in this activation (more than one when catching up)
 	int err;
 
 	RTIME ta_anterior=0;
@@ -281,18 +539,21 @@ void task_code_C(void *args) {
 	curtask=rt_task_self();
 	rt_task_inquire(curtask,&curtaskinfo);
 	taskArgs=(struct taskArgsStruct *)args;
-	printf("Task %s init, period:%llu\n", curtaskinfo.name, taskArgs->taskPeriod_ns);
+	RtLog_Printf(taskArgs->log, "Task %s init, period:%llu\n", curtaskinfo.name, taskArgs->taskPeriod_ns);
 		
-	/* Set task as periodic */
-	err=rt_task_set_periodic(NULL, TM_NOW, taskArgs->taskPeriod_ns);
+	/* Set task as periodic, first release one period from now */
+	release=rt_timer_read();
+	err=rt_task_set_periodic(NULL, release + taskArgs->taskPeriod_ns, taskArgs->taskPeriod_ns);
 	for(;;) {
+		overruns=0;
 		err=rt_task_wait_period(&overruns);
 		ta=rt_timer_read();
-		if(err) {
-			printf("task %s overrun!!!\n", curtaskinfo.name);
+		release+=(overruns + 1) * taskArgs->taskPeriod_ns;
+		if(err && err != -ETIMEDOUT) { // -ETIMEDOUT: overrun, handled below
+			RtLog_Printf(taskArgs->log, "task %s wait period error %d!!!\n", curtaskinfo.name, err);
 			break;
 		}
-		printf("\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
+		RtLog_Printf(taskArgs->log, "\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
 
 
 		if (ta_anterior == 0){
@@ -307,23 +568,138 @@ void task_code_C(void *args) {
 			if (ta - ta_anterior > tempo_maximo){
 				tempo_maximo = ta - ta_anterior;
 			}
+			HdrHist_Record(taskArgs->jitterHist, llabs((SRTIME)(ta - ta_anterior) - (SRTIME)taskArgs->taskPeriod_ns));
 			show = 1;
 		}
 
 		ta_anterior = ta;
 		if (show== 1){
-			printf("Task %s Tempo Minimo: %llu / Tempo Maximo: %llu\n\r",curtaskinfo.name, tempo_minimo, tempo_maximo);
+			RtLog_Printf(taskArgs->log, "Task %s Tempo Minimo: %llu / Tempo Maximo: %llu\n\r",curtaskinfo.name, tempo_minimo, tempo_maximo);
 		}
 		
 		
 		/* Task "load" */
-		Heavy_Work_C();
+		/* Overrun handling: abort the job or serve the missed releases (see overrun.h) */
+		if(!Overrun_Check(taskArgs->ovr, overruns, ta - release))
+			continue;
+		jobs = taskArgs->ovr->policy == OVERRUN_CATCHUP ? overruns + 1 : 1;
+		for(job = jobs; job > 0; job--) {
+			RTIME jr = release - (job - 1) * taskArgs->taskPeriod_ns; // Release of this job
+			tws=rt_timer_read();
+			Heavy_Work_C();
+			twe=rt_timer_read();
+			
+			/* Job accounting: release latency, execution and response times, deadline */
+			if(TaskStats_Record(taskArgs->stats, jr, ta, tws, twe))
+				ActTrace_Record(taskArgs->trace, jr, ta, tws, twe, (overruns ? ACT_TRACE_F_OVERRUN : 0) | ACT_TRACE_F_DEADLINE_MISS);
+			else
+				ActTrace_Record(taskArgs->trace, jr, ta, tws, twe, overruns ? ACT_TRACE_F_OVERRUN : 0);
+		}
 		
 	}
 	return;
 }
 
 
+/* **************************************************************************
+ *  Parses a list of up to 3 values in us ("A[,B,C]") into ns. The last
+ *  value given is repeated for the remaining tasks. Returns the number
+ *  of values given, 0 if the list is invalid
+ * **************************************************************************/
+int parse_us_list(char *s, uint64_t ns[3])
+{
+	char *end;
+	int i, j;
+
+	for(i = 0; i < 3; i++) {
+		ns[i] = strtoull(s, &end, 0) * 1000;
+		if(end == s || (*end != ',' && *end != '\0') || (*end == ',' && i == 2))
+			return 0;
+		s = end;
+		if(*s != ',') {
+			for(j = i + 1; j < 3; j++)
+				ns[j] = ns[i];
+			break;
+		}
+		s++;
+	}
+	return i < 3 ? i + 1 : 3;
+}
+
+/* CPU sets of tasks a, b and c, as CPULIST[:CPULIST:CPULIST]; the
+ * last one given applies to the following tasks. Returns 1, 0 if invalid */
+int parse_cpu_lists(char *s, cpu_set_t cpus[3])
+{
+	char *next;
+	int i, j;
+
+	for(i = 0; i < 3; i++) {
+		next = strchr(s, ':');
+		if(next != NULL)
+			*next++ = '\0';
+		if(CpuTopo_ParseList(s, &cpus[i]) <= 0)
+			return 0;
+		if(next == NULL) {
+			for(j = i + 1; j < 3; j++)
+				cpus[j] = cpus[i];
+			break;
+		}
+		s = next;
+	}
+	return 1;
+}
+
+/* Partitioned mode: assigns tasks a, b and c to the cores of part_cpus
+ * (bin-packing with the fixed priority test, see schedAnalysis.h) and
+ * sets task_cpus accordingly. Returns 0, -1 if the set does not fit */
+int partition(uint64_t exec_ns[3], uint64_t deadline_ns[3], enum saFit fit)
+{
+	const int prios[3] = { TASK_A_PRIO, TASK_B_PRIO, TASK_C_PRIO };
+	int i, unplaced;
+
+	for(i = 0; i < 3; i++) {
+		if(exec_ns[i] == 0) {
+			printf("Partitioned mode (-P) needs the execution time of every task (-C)\n");
+			return -1;
+		}
+		snprintf(part_tasks[i].name, sizeof(part_tasks[i].name), "Task %c", 'a' + i);
+		part_tasks[i].C = exec_ns[i];
+		part_tasks[i].T = TASK_A_PERIOD_NS;
+		part_tasks[i].D = deadline_ns[i] ? deadline_ns[i] : TASK_A_PERIOD_NS;
+		part_tasks[i].prio = prios[i];
+	}
+	unplaced = SchedAnalysis_Partition(part_tasks, 3, part_ncpus, fit, SA_TEST_FP);
+	printf("Partitioned over %d cores (%s decreasing)\n", part_ncpus, fit == SA_FIRST_FIT ? "first-fit" : "worst-fit");
+	for(i = 0; i < 3; i++) {
+		if(part_tasks[i].core < 0) {
+			printf("%s (U %.4f) does not fit on any core\n", part_tasks[i].name,
+				(double)part_tasks[i].C / part_tasks[i].T);
+			continue;
+		}
+		CPU_ZERO(&task_cpus[i]);
+		CPU_SET(part_cpus[part_tasks[i].core], &task_cpus[i]);
+		printf("%s -> core %d (CPU %d), WCRT %.3f us\n", part_tasks[i].name, part_tasks[i].core,
+			part_cpus[part_tasks[i].core], (double)part_tasks[i].R / 1000);
+	}
+	return unplaced ? -1 : 0;
+}
+
+/* Per core utilization and the measured jitter of its tasks */
+void print_partition(void)
+{
+	struct hdrHist *hists[3] = { &task_a_hist, &task_b_hist, &task_c_hist };
+	int c, i;
+
+	for(c = 0; c < part_ncpus; c++) {
+		printf("Core %d (CPU %d): utilization %.4f", c, part_cpus[c], SchedAnalysis_Utilization(part_tasks, 3, c));
+		for(i = 0; i < 3; i++)
+			if(part_tasks[i].core == c)
+				printf(", %s jitter p99 %.3f us max %.3f us", part_tasks[i].name,
+					(double)HdrHist_Percentile(hists[i], 99.0) / 1000, (double)hists[i]->max / 1000);
+		printf("\n");
+	}
+}
+
 /* **************************************************************************
  *  Catch control+c to allow a controlled termination
  * **************************************************************************/
@@ -345,137 +721,54 @@ void wait_for_ctrl_c(void) {
 
 
 /* **************************************************************************
- *  Task load implementation. In the case integrates numerically a function
+ *  Task load implementation. In the case integrates numerically a function,
+ *  with the fastest kernel for this CPU (see integKernel.h), for the
+ *  execution time given with -C (see loadCal.h)
  * **************************************************************************/
-#define f(x) 1/(1+pow(x,2)) /* Define function to integrate*/
 void Heavy_Work(void)
 {
-	float lower, upper, integration=0.0, stepSize, k;
-	int i, subInterval;
-	
-	RTIME ts, // Function start time
-		  tf; // Function finish time
+	double integration;
 			
 	static int first = 0; // Flag to signal first execution		
 	
-	/* Get start time */
-	ts=rt_timer_read();
-
-	
-	/* Integration parameters */
-	/*These values can be tunned to cause a desired load*/
-	lower=0;
-	upper=100;
-	subInterval=1000000;
-
-	 /* Calculation */
-	 /* Finding step size */
-	 stepSize = (upper - lower)/subInterval;
-
-	 /* Finding Integration Value */
-	 integration = f(lower) + f(upper);
-	 for(i=1; i<= subInterval-1; i++)
-	 {
-		k = lower + i*stepSize;
-		integration = integration + 2 * f(k);
- 	}
-	integration = integration * stepSize/2;
+	 /* Calculation (timed by the load calibration) */
+	integration = LoadCal_Run(&task_a_load);
  	
- 	/* Get finish time and show results */
+ 	/* Show results */
  	if (!first) {
-
-		tf=rt_timer_read();
-		tf-=ts;  // Compute time difference form start to finish
-		
-		printf("Integration value is: %.3f. It took %9llu ns to compute.\n", integration, tf);
+		RtLog_Printf(&task_a_log, "Integration value is: %.3f. It took %9llu ns to compute.\n", integration, (unsigned long long)task_a_load.max_ns);
 		first = 1;
 	}
 }
 
 void Heavy_Work_B(void)
 {
-	float lower, upper, integration=0.0, stepSize, k;
-	int i, subInterval;
-	
-	RTIME ts, // Function start time
-		  tf; // Function finish time
+	double integration;
 			
 	static int first_B = 0; // Flag to signal first execution		
 	
-	/* Get start time */
-	ts=rt_timer_read();
-
-	
-	/* Integration parameters */
-	/*These values can be tunned to cause a desired load*/
-	lower=0;
-	upper=100;
-	subInterval=1000000;
-
-	 /* Calculation */
-	 /* Finding step size */
-	 stepSize = (upper - lower)/subInterval;
-
-	 /* Finding Integration Value */
-	 integration = f(lower) + f(upper);
-	 for(i=1; i<= subInterval-1; i++)
-	 {
-		k = lower + i*stepSize;
-		integration = integration + 2 * f(k);
- 	}
-	integration = integration * stepSize/2;
+	 /* Calculation (timed by the load calibration) */
+	integration = LoadCal_Run(&task_b_load);
  	
- 	/* Get finish time and show results */
+ 	/* Show results */
  	if (!first_B) {
-
-		tf=rt_timer_read();
-		tf-=ts;  // Compute time difference form start to finish
-		
-		printf("Integration value is: %.3f. It took %9llu ns to compute.\n", integration, tf);
+		RtLog_Printf(&task_b_log, "Integration value is: %.3f. It took %9llu ns to compute.\n", integration, (unsigned long long)task_b_load.max_ns);
 		first_B = 1;
 	}
 }
 
 void Heavy_Work_C(void)
 {
-	float lower, upper, integration=0.0, stepSize, k;
-	int i, subInterval;
-	
-	RTIME ts, // Function start time
-		  tf; // Function finish time
+	double integration;
 			
 	static int first_C = 0; // Flag to signal first execution		
 	
-	/* Get start time */
-	ts=rt_timer_read();
-
-	
-	/* Integration parameters */
-	/*These values can be tunned to cause a desired load*/
-	lower=0;
-	upper=100;
-	subInterval=1000000;
-
-	 /* Calculation */
-	 /* Finding step size */
-	 stepSize = (upper - lower)/subInterval;
-
-	 /* Finding Integration Value */
-	 integration = f(lower) + f(upper);
-	 for(i=1; i<= subInterval-1; i++)
-	 {
-		k = lower + i*stepSize;
-		integration = integration + 2 * f(k);
- 	}
-	integration = integration * stepSize/2;
+	 /* Calculation (timed by the load calibration) */
+	integration = LoadCal_Run(&task_c_load);
  	
- 	/* Get finish time and show results */
+ 	/* Show results */
  	if (!first_C) {
-
-		tf=rt_timer_read();
-		tf-=ts;  // Compute time difference form start to finish
-		
-		printf("Integration value is: %.3f. It took %9llu ns to compute.\n", integration, tf);
+		RtLog_Printf(&task_c_log, "Integration value is: %.3f. It took %9llu ns to compute.\n", integration, (unsigned long long)task_c_load.max_ns);
 		first_C = 1;
 	}
 }
@@ -8,9 +8,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <math.h>
+#include <fcntl.h>
+#include <errno.h>
 
 
 
@@ -22,6 +25,13 @@
 
 #include <alchemy/queue.h>
 
+#include "actTrace.h"
+#include "hdrHist.h"
+#include "asyncWriter.h"
+#include "sampleLog.h"
+#include "sensorStream.h"
+#include "sensorFilter.h"
+
 #define MS_2_NS(ms)(ms*1000*1000) /* Convert ms to ns */
 
 /* *****************************************************
@@ -30,6 +40,7 @@
  struct taskArgsStruct {
 	 RTIME taskPeriod_ns;
 	 int some_other_arg;
+	 struct actTrace *trace;	// Activation trace (-T option)
  };
 
 /* *******************
@@ -45,6 +56,9 @@
 
 #define TASK_C_PRIO 25 	// RT priority [0..99]
 
+#define BATCH_MAX 1024		// Largest batch of the PROCESSING and STORAGE tasks (-b)
+#define LINE_MAX_LEN 16		// Longest output line ("-2147483648\n")
+
 RT_TASK task_SENSOR_desc; // Task decriptor
 RT_TASK task_PROCESSING_desc; // Task decriptor
 RT_TASK task_STORAGE_desc; // Task decriptor
@@ -61,24 +75,176 @@ void Heavy_Work_PROCESSING(void);      	/* Load task */
 void task_code_PROCESSING(void *args); 	/* Task body */
 void Heavy_Work_STORAGE(void);      	/* Load task */
 void task_code_STORAGE(void *args); 	/* Task body */
+void print_storage_stats(void);
+void print_usage(const char *prog);
+int write_output(const char *data, size_t len);
 
-int LINHA = 0;
+struct sensorStream sensor_stream; // Sensor data, read by the SENSOR task
+struct filter sample_filter; // Filter of the PROCESSING task (-f option)
 
 RT_QUEUE queue_sensor;
 RT_QUEUE queue_processing;
 
+struct actTrace sensor_trace; // Activation trace of the SENSOR task (only used with -T)
+
+/* Batching: PROCESSING and STORAGE take up to batch_max samples per
+ * wakeup, waiting for more up to batch_wait_ns after the first one */
+int batch_max = 16;
+RTIME batch_wait_ns = 0;
+RTIME fsync_ns = 0;	// Periodic fsync of the output (0: none)
+int out_fd;		// Output file, written by STORAGE
+int async_out = 0;	// STORAGE writes through out_writer (-a)
+struct asyncWriter out_writer;
+int binary_out = 0;	// STORAGE writes a binary sample log (-F bin), through out_log
+struct sampleLog out_log;
+int verbose = 0;	// Print every activation and sample (-v)
+unsigned long long sensor_overruns = 0;	// Releases missed by the SENSOR task
+
+/* Storage statistics */
+struct {
+	uint64_t samples, batches, fsyncs;
+	RTIME first, last;		// First sample acquisition, last write
+	struct hdrHist e2e;		// Acquisition to write latency
+} storage_stats;
+
+int receive_batch(RT_QUEUE *q, struct sensorSample *smp, int max);
+
 /* ******************
 * Main function
 * *******************/ 
 int main(int argc, char *argv[]) {
-	int err; 
+	int err, opt; 
+	char *tracefile = NULL;
+	char *datafile = "sensordata.txt";
+	enum sensorEof eof = SENSOR_EOF_STOP;
+	unsigned channel = 0;
+	char *filterspec = "ma:5";
+	char *outfile = "sensordataFiltered.txt";
+	enum awBackend backend = AW_AUTO;
+	unsigned blockSamples = 0;
+	const char *data;
+	size_t len;
+	RTIME period_ns = ACK_PERIOD_MS;
+	char desc[128];
+	char *end;
 	struct taskArgsStruct taskSENSORArgs;
 	struct taskArgsStruct taskPROCESSINGArgs;
 	struct taskArgsStruct taskSTORAGEArgs;
 
     
-	FILE *file;
-    fopen("sensordataFiltered.txt","w");
+	/* Process options */
+	while((opt = getopt(argc, argv, "T:i:lc:f:o:F:a:p:b:w:s:v")) != -1) {
+		switch(opt) {
+			case 'T':	// Activation trace of the SENSOR task
+				tracefile = optarg;
+				break;
+			case 'i':	// Sensor data file
+				datafile = optarg;
+				break;
+			case 'l':	// Loop over the data at its end (default: stop)
+				eof = SENSOR_EOF_LOOP;
+				break;
+			case 'c':	// Channel id of the samples
+				channel = atoi(optarg);
+				break;
+			case 'f':	// Filter of the PROCESSING task (see sensorFilter.h)
+				filterspec = optarg;
+				break;
+			case 'o':	// Output file of the STORAGE task
+				outfile = optarg;
+				break;
+			case 'F':	// Output format: text (default) or bin[:BLOCK] (see sampleLog.h)
+				blockSamples = 0;
+				if(strcmp(optarg, "text") == 0)
+					binary_out = 0;
+				else if(strcmp(optarg, "bin") == 0 || (strncmp(optarg, "bin:", 4) == 0
+					&& (blockSamples = strtoul(optarg + 4, &end, 10)) > 0 && *end == '\0'))
+					binary_out = 1;
+				else {
+					print_usage(argv[0]);
+					return -1;
+				}
+				break;
+			case 'a':	// Asynchronous output (see asyncWriter.h)
+				async_out = 1;
+				if(strcmp(optarg, "uring") == 0)
+					backend = AW_IO_URING;
+				else if(strcmp(optarg, "threads") == 0)
+					backend = AW_THREADS_POOL;
+				else if(strcmp(optarg, "auto") == 0)
+					backend = AW_AUTO;
+				else {
+					print_usage(argv[0]);
+					return -1;
+				}
+				break;
+			case 'p':	// Period of the SENSOR task (us)
+				period_ns = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			case 'b':	// Batch size of the PROCESSING and STORAGE tasks
+				batch_max = atoi(optarg);
+				if(batch_max < 1 || batch_max > BATCH_MAX) {
+					printf("Batch size must be 1..%d\n", BATCH_MAX);
+					return -1;
+				}
+				break;
+			case 'w':	// Latency bound of a batch (us)
+				batch_wait_ns = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			case 's':	// fsync period of the output (ms)
+				fsync_ns = strtoull(optarg, NULL, 10) * 1000000;
+				break;
+			case 'v':	// Print every activation and sample
+				verbose = 1;
+				break;
+			default:
+				print_usage(argv[0]);
+				return -1;
+		}
+	}
+	/* Map the data now: the SENSOR task does no file I/O */
+	err = SensorStream_Open(&sensor_stream, datafile, eof);
+	if(err) {
+		printf("Error opening sensor data file %s (error code = %d)\n", datafile, err);
+		return err;
+	}
+	sensor_stream.channel = channel;
+	err = Filter_Init(&sample_filter, filterspec);
+	if(err) {
+		printf("Invalid filter %s (error code = %d)\n", filterspec, err);
+		return err;
+	}
+	printf("Filter: %s\n", Filter_Describe(&sample_filter, desc, sizeof(desc)));
+	if(tracefile != NULL) {
+		err = ActTrace_Open(&sensor_trace, tracefile, "Task SENSOR", period_ns, 0);
+		if(err) {
+			printf("Error creating trace file %s (error code = %d)\n", tracefile, err);
+			return err;
+		}
+	}
+
+	out_fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(out_fd < 0) {
+		printf("Error creating output file %s (error code = %d)\n", outfile, -errno);
+		return -errno;
+	}
+	if(async_out) {
+		err = AsyncWriter_Open(&out_writer, out_fd, 0, backend);
+		if(err) {
+			printf("Error starting the asynchronous writer (error code = %d)\n", err);
+			return err;
+		}
+		printf("Output: asynchronous, %s\n", AsyncWriter_BackendName(&out_writer));
+	}
+	if(binary_out) {
+		err = SampleLog_Open(&out_log, blockSamples);
+		if(err) {
+			printf("Invalid block size %u (error code = %d)\n", blockSamples, err);
+			return err;
+		}
+		printf("Output: binary sample log, blocks of %u samples\n", out_log.blockSamples);
+	}
+	HdrHist_Init(&storage_stats.e2e, HDR_DEFAULT_PRECISION_BITS);
 	/* Lock memory to prevent paging */
 	mlockall(MCL_CURRENT|MCL_FUTURE); 
 
@@ -111,7 +277,8 @@ int main(int argc, char *argv[]) {
 
 
     
-	taskSENSORArgs.taskPeriod_ns = ACK_PERIOD_MS; 	
+	taskSENSORArgs.taskPeriod_ns = period_ns;	
+	taskSENSORArgs.trace = &sensor_trace;
     rt_task_start(&task_SENSOR_desc, &task_code_SENSOR, (void *)&taskSENSORArgs);
     rt_task_start(&task_PROCESSING_desc, &task_code_PROCESSING, (void *)&taskPROCESSINGArgs);
     rt_task_start(&task_STORAGE_desc, &task_code_STORAGE, (void *)&taskSTORAGEArgs);
@@ -119,6 +286,32 @@ int main(int argc, char *argv[]) {
     
 	/* wait for termination signal */	
 	wait_for_ctrl_c();
+	/* Stop the tasks before releasing what they use */
+	rt_task_delete(&task_SENSOR_desc);
+	rt_task_delete(&task_PROCESSING_desc);
+	rt_task_delete(&task_STORAGE_desc);
+	ActTrace_Close(&sensor_trace);
+	printf("Sensor: %llu samples, %llu bad lines, %llu loops over %s, %llu releases missed\n", (unsigned long long)sensor_stream.samples,
+		(unsigned long long)sensor_stream.bad, (unsigned long long)sensor_stream.loops, datafile, sensor_overruns);
+	if(binary_out) { // The last block and the index
+		err = SampleLog_Finish(&out_log);
+		data = SampleLog_Take(&out_log, &len);
+		if(err || write_output(data, len))
+			printf("Error ending the sample log, its index will have to be rebuilt\n");
+	}
+	if(async_out)
+		AsyncWriter_Close(&out_writer);
+	print_storage_stats();
+	if(async_out)
+		AsyncWriter_Print(&out_writer, stdout);
+	if(binary_out) {
+		printf("Sample log: %llu samples in %zu blocks, %.2f bytes/sample\n", (unsigned long long)out_log.samples,
+			out_log.blocks, out_log.samples ? (double)out_log.offset / out_log.samples : 0.0);
+		SampleLog_Close(&out_log);
+	}
+	SensorStream_Close(&sensor_stream);
+	Filter_Free(&sample_filter);
+	close(out_fd);
 
 	return 0;
 		
@@ -133,8 +326,12 @@ void task_code_SENSOR(void *args) {
 	struct taskArgsStruct *taskArgs;
 
 	RTIME ta=0;
+	RTIME release; // Expected release of the current activation
+	RTIME tws=0;   // Work start (trace mode)
 	unsigned long overruns;
 	int err;
+	struct sensorSample *msg;
+	struct sensorSample smp;
 	
 	/* Get task information */
 	curtask=rt_task_self();
@@ -144,40 +341,41 @@ void task_code_SENSOR(void *args) {
 	
    
 	
-	/* Set task as periodic */
-	err=rt_task_set_periodic(NULL, TM_NOW, taskArgs->taskPeriod_ns);
+	/* Set task as periodic, first release one period from now */
+	release=rt_timer_read();
+	err=rt_task_set_periodic(NULL, release + taskArgs->taskPeriod_ns, taskArgs->taskPeriod_ns);
 	for(;;) {
+		overruns=0;
 		err=rt_task_wait_period(&overruns);
 		ta=rt_timer_read();
-		if(err) {
-			printf("task %s overrun!!!\n", curtaskinfo.name);
+		release+=(overruns + 1) * taskArgs->taskPeriod_ns;
+		if(err == -ETIMEDOUT) { // Releases missed: counted, the task goes on from the latest
+			if(verbose)
+				printf("task %s overrun!!!\n", curtaskinfo.name);
+			sensor_overruns += overruns;
+		} else if(err) {
+			printf("task %s wait period error %d\n", curtaskinfo.name, err);
 			break;
 		}
-		printf("\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
+		if(verbose)
+			printf("\nTask %s activation at time %llu\n", curtaskinfo.name,ta);
 		
 		/* Task "load" */
-        FILE *fileStream; 
-   
-        fileStream = fopen ("sensordata.txt", "r"); 
-
-        char line[18]; 
-        void *msg;
-        int i = 0; 
-        int len;
-        // rt_queue_bind(&queue_sensor,"queue_sensor",TM_INFINITE);
-        while (fgets(line, sizeof(line), fileStream)) { 
-            if(i == LINHA ) 
-            { 
-                len = strlen(line) + 1;
-                msg = rt_queue_alloc(&queue_sensor,len);
-                strcpy(msg,line);
-                rt_queue_send(&queue_sensor,msg,len,Q_NORMAL); 
-                
-            } 
-            i++;
-        } 
-        LINHA ++;
-        fclose(fileStream); 
+		if(ActTrace_Enabled(taskArgs->trace))
+			tws=rt_timer_read();
+		if(SensorStream_Read(&sensor_stream, &smp) == 0) {
+			printf("Task %s: end of sensor data\n", curtaskinfo.name);
+			break;
+		}
+		smp.timestamp = ta;
+		msg = rt_queue_alloc(&queue_sensor, sizeof(*msg));
+		if(msg != NULL) {
+			*msg = smp;
+			rt_queue_send(&queue_sensor, msg, sizeof(*msg), Q_NORMAL);
+		} else
+			printf("Task %s: queue full, sample %llu lost\n", curtaskinfo.name, (unsigned long long)smp.seq);
+		if(ActTrace_Enabled(taskArgs->trace))
+			ActTrace_Record(taskArgs->trace, release, ta, tws, rt_timer_read(), 0);
 
 		
 	}
@@ -200,74 +398,28 @@ void task_code_PROCESSING(void *args) {
     
     
 	rt_queue_bind(&queue_sensor,"queue_sensor",TM_INFINITE);
-    ssize_t len;
-    void* msg;
-    void* msg2;
-    int numeros[5];
-	int pos;
-    int aux=0;
-	int media = 0;
-    while (( len = rt_queue_receive(&queue_sensor,&msg,TM_INFINITE)) > 0){
-        printf("TASK PROCESSING");
-        printf("\nreceived message> ptr=%p, s=%s",msg,(const char *)msg);
-        rt_queue_free(&queue_sensor,msg);
-
-        if (aux > 4){
-			
-            for(int i=0;i<4;i++){
-                numeros[i] = numeros[i+1];
-            }
-            numeros[4] = atoi(msg);
-        }
-        else{
-		
-            numeros[pos] = atoi(msg);
-            pos++;
-        }
-        
-        if (aux >= 4 && pos >= 4){
-			
-            for (int i=0;i<=4;i++){
-				
-                media = media + numeros[i];
-            }
-			
-            media = round((double)media/5);
-
-
-			char line1[200];
-			sprintf(line1,"%d",media);
-			int len1 = strlen(line1) +1;
-			msg2 = rt_queue_alloc(&queue_processing,len1);
-			strcpy(msg2,line1);
-			int x = rt_queue_send(&queue_processing,msg2,len1,Q_NORMAL); 
-        }
-		// else{
-		// 	printf("pos : %d",pos);
-		// 	for (int i=0;i<pos;i++){
-				
-		// 		printf("\n%d",numeros[i]);
-        //         media = media + numeros[i];
-        //     }
-        //     media = round((double)media/pos);
-		// 	printf("\n%d",media);
-
-
-		// 	char line1[200];
-		// 	sprintf(line1,"%d",media);
-		// 	int len1 = strlen(line1) +1;
-		// 	msg2 = rt_queue_alloc(&queue_processing,len1);
-		// 	strcpy(msg2,line1);
-		// 	int x = rt_queue_send(&queue_processing,msg2,len1,Q_NORMAL); 
-		// }
-        aux++;
-
-	
-		media = 0;
-        
-    }
+	static struct sensorSample batch[BATCH_MAX];
+	struct sensorSample *out;
+	double y;
+	int n;
+	while ((n = receive_batch(&queue_sensor, batch, batch_max)) > 0){
+		for(int i=0;i<n;i++){
+			if(verbose)
+				printf("TASK PROCESSING\nreceived sample> seq=%llu, value=%d\n",(unsigned long long)batch[i].seq,batch[i].value);
+			if(!Filter_Step(&sample_filter, batch[i].value, &y))
+				continue; // Window not full yet
+
+			out = rt_queue_alloc(&queue_processing,sizeof(*out));
+			if(out == NULL) {
+				printf("Task %s: queue full, sample %llu lost\n", curtaskinfo.name, (unsigned long long)batch[i].seq);
+				continue;
+			}
+			*out = batch[i]; // Keeps the sequence number, timestamp and channel
+			out->value = (int32_t)round(y);
+			rt_queue_send(&queue_processing,out,sizeof(*out),Q_NORMAL);
+		}
+	}
 
-   
     rt_queue_unbind(&queue_sensor);
 	
 		
@@ -290,20 +442,50 @@ void task_code_STORAGE(void *args) {
     
     
 	rt_queue_bind(&queue_processing,"queue_processing",TM_INFINITE);
-    ssize_t len;
-    void* msg;
-   
-    FILE *file;
-    file = fopen("sensordataFiltered.txt","a");
-    while (( len = rt_queue_receive(&queue_processing,&msg,TM_INFINITE)) > 0){
-        printf("\nTASK STORAGE");
-        printf("\nreceived message> ptr=%p, s=%s\n",msg,(const char *)msg);
-        rt_queue_free(&queue_processing,msg);
-        fputs(msg,file);
-		fputs("\n",file);
-    }
-
-    fclose(file);
+	static struct sensorSample batch[BATCH_MAX];
+	static char buf[BATCH_MAX * LINE_MAX_LEN];
+	const char *data = buf;
+	RTIME now, lastSync = rt_timer_read();
+	size_t used;
+	int n, sync;
+	while ((n = receive_batch(&queue_processing, batch, batch_max)) > 0){
+		/* Encode or format the batch, then write it at once */
+		sync = fsync_ns && rt_timer_read() - lastSync >= fsync_ns;
+		used = 0;
+		for(int i=0;i<n;i++){
+			if(verbose)
+				printf("\nTASK STORAGE\nreceived sample> seq=%llu, value=%d\n",(unsigned long long)batch[i].seq,batch[i].value);
+			if(!binary_out)
+				used += snprintf(buf + used, sizeof(buf) - used, "%d\n", batch[i].value);
+			else if((err = SampleLog_Append(&out_log, &batch[i])))
+				printf("Task %s: sample %llu not logged (error code = %d)\n", curtaskinfo.name, (unsigned long long)batch[i].seq, err);
+		}
+		if(binary_out) { // Only whole blocks are written: end the current one before an fsync
+			if(sync)
+				SampleLog_Flush(&out_log);
+			data = SampleLog_Take(&out_log, &used);
+		}
+		if(used && (err = write_output(data, used)))
+			printf("Task %s: write error %d\n", curtaskinfo.name, err);
+
+		now = rt_timer_read();
+		if(sync) {
+			if(async_out)
+				AsyncWriter_Sync(&out_writer);
+			else
+				fsync(out_fd);
+			storage_stats.fsyncs++;
+			lastSync = now;
+		}
+		if(storage_stats.samples == 0)
+			storage_stats.first = batch[0].timestamp;
+		for(int i=0;i<n;i++)
+			HdrHist_Record(&storage_stats.e2e, now - batch[i].timestamp);
+		storage_stats.samples += n;
+		storage_stats.batches++;
+		storage_stats.last = now;
+	}
+
     rt_queue_unbind(&queue_processing);
 	
 		
@@ -311,6 +493,66 @@ void task_code_STORAGE(void *args) {
 }
 
 
+/* Receives a batch of samples: waits for the first, then takes up to
+ * "max" in total, those already queued and those arriving up to
+ * batch_wait_ns after the first. Returns their number, or an error code */
+int receive_batch(RT_QUEUE *q, struct sensorSample *smp, int max)
+{
+	void *msg;
+	ssize_t len;
+	RTIME deadline, now;
+	int n = 0;
+
+	len = rt_queue_receive(q, &msg, TM_INFINITE);
+	if(len < 0)
+		return len;
+	deadline = rt_timer_read() + batch_wait_ns;
+	for(;;) {
+		smp[n++] = *(struct sensorSample *)msg;
+		rt_queue_free(q, msg);
+		if(n == max)
+			break;
+		now = batch_wait_ns ? rt_timer_read() : deadline;
+		if(rt_queue_receive(q, &msg, now < deadline ? deadline - now : TM_NONBLOCK) < 0)
+			break; // Nothing more in time
+	}
+	return n;
+}
+
+/* Writes the output of STORAGE, through the asynchronous writer with
+ * -a. Returns 0 or -errno */
+int write_output(const char *data, size_t len)
+{
+	ssize_t w;
+
+	if(async_out) {
+		w = AsyncWriter_Append(&out_writer, data, len);
+		AsyncWriter_Flush(&out_writer);
+		return w;
+	}
+	for(size_t done = 0; done < len; done += w)
+		if((w = write(out_fd, data + done, len - done)) < 0)
+			return -errno;
+	return 0;
+}
+
+void print_usage(const char *prog)
+{
+	printf("Usage: %s [-T TRACEFILE] [-i DATAFILE] [-l] [-c CHANNEL] [-f none|ma:W|ema:ALPHA|median:W|fir:H0,H1,...]\n"
+		"\t[-o OUTFILE] [-F text|bin[:BLOCK]] [-a auto|uring|threads] [-p PERIOD_US] [-b BATCH] [-w WAIT_US] [-s FSYNC_MS] [-v]\n", prog);
+}
+
+void print_storage_stats(void)
+{
+	double secs = (double)(storage_stats.last - storage_stats.first) / 1e9;
+
+	printf("Storage: %llu samples in %llu batches (%.1f samples/batch, max %d), %llu fsyncs, throughput %.1f samples/s\n",
+		(unsigned long long)storage_stats.samples, (unsigned long long)storage_stats.batches,
+		storage_stats.batches ? (double)storage_stats.samples / storage_stats.batches : 0.0, batch_max,
+		(unsigned long long)storage_stats.fsyncs, secs > 0 ? storage_stats.samples / secs : 0.0);
+	HdrHist_Print(&storage_stats.e2e, "  End-to-end latency", stdout);
+}
+
 /* **************************************************************************
  *  Catch control+c to allow a controlled termination
  * **************************************************************************/
@@ -0,0 +1,549 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Alchemy task, timer and queue API on POSIX threads - implementation
+ * (see alchemy/task.h and alchemy/queue.h)
+ *
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include <alchemy/task.h>
+#include <alchemy/timer.h>
+#include <alchemy/queue.h>
+
+#define NS_PER_S 1000000000ULL
+
+/* ******************
+ * Timer
+ * ******************/
+
+RTIME rt_timer_read(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (RTIME)ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+SRTIME rt_timer_ns2ticks(SRTIME ns)
+{
+	return ns;
+}
+
+SRTIME rt_timer_ticks2ns(SRTIME ticks)
+{
+	return ticks;
+}
+
+static struct timespec NsToTs(RTIME ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / NS_PER_S;
+	ts.tv_nsec = ns % NS_PER_S;
+	return ts;
+}
+
+/* ******************
+ * Tasks
+ * ******************/
+
+struct alchemyTask {
+	char name[XNOBJECT_NAME_LEN];
+	int prio, mode, stksize;
+	cpu_set_t cpus;
+	int hasCpus;			// Affinity given (rt_task_set_affinity)
+	pthread_t thread;
+	int started;
+	pid_t pid;
+	void (*entry)(void *arg);
+	void *arg;
+	RTIME next;			// Next release (periodic task)
+	RTIME period;			// 0: not periodic
+};
+
+static __thread RT_TASK self;		// Task of the calling thread
+
+static struct alchemyTask *TaskObj(RT_TASK *task)
+{
+	return task != NULL ? task->obj : self.obj;
+}
+
+int rt_task_create(RT_TASK *task, const char *name, int stksize, int prio, int mode)
+{
+	struct alchemyTask *t;
+
+	if(prio < 0 || prio > 99)
+		return -EINVAL;
+	t = calloc(1, sizeof(*t));
+	if(t == NULL)
+		return -ENOMEM;
+	snprintf(t->name, sizeof(t->name), "%s", name != NULL ? name : "");
+	t->prio = prio;
+	t->mode = mode;
+	t->stksize = stksize;
+	task->obj = t;
+	return 0;
+}
+
+static void *TaskBody(void *arg)
+{
+	struct alchemyTask *t = arg;
+	sigset_t set;
+
+	/* Termination signals are for the main thread (wait_for_ctrl_c) */
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	t->pid = syscall(SYS_gettid);
+	self.obj = t;
+	t->entry(t->arg);
+	return NULL;
+}
+
+int rt_task_start(RT_TASK *task, void (*entry)(void *arg), void *arg)
+{
+	struct alchemyTask *t = task->obj;
+	struct sched_param param;
+	pthread_attr_t attr;
+	int err;
+
+	if(t == NULL)
+		return -EINVAL;
+	if(t->started)
+		return -EBUSY;
+	t->entry = entry;
+	t->arg = arg;
+
+	pthread_attr_init(&attr);
+	if(t->stksize > 0)
+		pthread_attr_setstacksize(&attr, t->stksize < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : t->stksize);
+	if(t->hasCpus)
+		pthread_attr_setaffinity_np(&attr, sizeof(t->cpus), &t->cpus);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, t->prio > 0 ? SCHED_FIFO : SCHED_OTHER);
+	param.sched_priority = t->prio;
+	pthread_attr_setschedparam(&attr, &param);
+
+	err = pthread_create(&t->thread, &attr, TaskBody, t);
+	if(err == EPERM && t->prio > 0) {
+		fprintf(stderr, "Warning: %s: no privilege for SCHED_FIFO, running as SCHED_OTHER\n", t->name);
+		pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+		param.sched_priority = 0;
+		pthread_attr_setschedparam(&attr, &param);
+		err = pthread_create(&t->thread, &attr, TaskBody, t);
+	}
+	pthread_attr_destroy(&attr);
+	if(err)
+		return -err;
+	t->started = 1; // Left joinable whatever the mode, for rt_task_delete
+	return 0;
+}
+
+int rt_task_set_affinity(RT_TASK *task, const cpu_set_t *cpus)
+{
+	struct alchemyTask *t = TaskObj(task);
+
+	if(t == NULL)
+		return -EINVAL;
+	t->cpus = *cpus;
+	t->hasCpus = 1;
+	if(t->started)
+		return -pthread_setaffinity_np(t->thread, sizeof(t->cpus), &t->cpus);
+	return 0;
+}
+
+/* The first release is at idate (now with TM_NOW); a null period
+ * makes the task non periodic */
+int rt_task_set_periodic(RT_TASK *task, RTIME idate, RTIME period)
+{
+	struct alchemyTask *t = TaskObj(task);
+
+	if(t == NULL)
+		return -EPERM;
+	t->next = idate == TM_NOW ? rt_timer_read() : idate;
+	t->period = period;
+	return 0;
+}
+
+/* Waits for the next release. When it is already past, returns at
+ * once; if later releases have passed too (the task is over one
+ * period late), they are skipped: returns -ETIMEDOUT with their
+ * number in *overruns_r */
+int rt_task_wait_period(unsigned long *overruns_r)
+{
+	struct alchemyTask *t = self.obj;
+	struct timespec ts;
+	RTIME now, overruns;
+
+	if(t == NULL)
+		return -EPERM;
+	if(t->period == 0)
+		return -EWOULDBLOCK;
+
+	now = rt_timer_read();
+	if(now < t->next) {
+		ts = NsToTs(t->next);
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+		now = rt_timer_read();
+	}
+	overruns = now > t->next ? (now - t->next) / t->period : 0;
+	t->next += (overruns + 1) * t->period;
+	if(overruns_r != NULL)
+		*overruns_r = overruns;
+	return overruns ? -ETIMEDOUT : 0;
+}
+
+RT_TASK *rt_task_self(void)
+{
+	return self.obj != NULL ? &self : NULL;
+}
+
+int rt_task_inquire(RT_TASK *task, RT_TASK_INFO *info)
+{
+	struct alchemyTask *t = TaskObj(task);
+
+	if(t == NULL)
+		return -EINVAL;
+	memset(info, 0, sizeof(*info));
+	info->prio = t->prio;
+	info->pid = t->pid;
+	snprintf(info->name, sizeof(info->name), "%s", t->name);
+	return 0;
+}
+
+int rt_task_sleep(RTIME delay)
+{
+	struct timespec ts = NsToTs(delay);
+
+	if(clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL) == EINTR)
+		return -EINTR;
+	return 0;
+}
+
+int rt_task_yield(void)
+{
+	sched_yield();
+	return 0;
+}
+
+int rt_task_join(RT_TASK *task)
+{
+	struct alchemyTask *t = task->obj;
+
+	if(t == NULL || !t->started || !(t->mode & T_JOINABLE))
+		return -EINVAL;
+	return -pthread_join(t->thread, NULL);
+}
+
+/* Cancels the task (at its next wait, sleep or I/O) and waits for it */
+int rt_task_delete(RT_TASK *task)
+{
+	struct alchemyTask *t = TaskObj(task);
+
+	if(t == NULL)
+		return -EINVAL;
+	if(t == self.obj)
+		pthread_exit(NULL);
+	if(t->started) {
+		pthread_cancel(t->thread);
+		pthread_join(t->thread, NULL);
+	}
+	task->obj = NULL;
+	free(t);
+	return 0;
+}
+
+/* ******************
+ * Queues
+ * ******************/
+
+struct queueMsg {
+	struct queueMsg *next;
+	size_t alloc;			// Charged to the pool
+	size_t size;			// Sent
+	max_align_t data[];
+};
+
+struct alchemyQueue {
+	char name[XNOBJECT_NAME_LEN];
+	pthread_mutex_t lock;
+	pthread_cond_t avail;		// A message was queued
+	size_t poolsize, used;
+	size_t qlimit, count;		// Queued messages (limit, Q_UNLIMITED: none)
+	int waiters;			// Receivers blocked
+	struct queueMsg *head, *tail;
+	struct alchemyQueue *nextQueue;	// Registry
+};
+
+/* Queues by name, for rt_queue_bind */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t created;
+	struct alchemyQueue *list;
+} registry = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL };
+
+static struct alchemyQueue *FindQueue(const char *name)
+{
+	struct alchemyQueue *aq;
+
+	for(aq = registry.list; aq != NULL; aq = aq->nextQueue)
+		if(strcmp(aq->name, name) == 0)
+			return aq;
+	return NULL;
+}
+
+/* Absolute time "timeout" ns from now, on "clock" */
+static struct timespec Deadline(clockid_t clock, RTIME timeout)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return NsToTs((RTIME)ts.tv_sec * NS_PER_S + ts.tv_nsec + timeout);
+}
+
+int rt_queue_create(RT_QUEUE *q, const char *name, size_t poolsize, size_t qlimit, int mode)
+{
+	struct alchemyQueue *aq;
+	pthread_condattr_t attr;
+
+	(void)mode;
+	if(poolsize == 0)
+		return -EINVAL;
+	aq = calloc(1, sizeof(*aq));
+	if(aq == NULL)
+		return -ENOMEM;
+	snprintf(aq->name, sizeof(aq->name), "%s", name != NULL ? name : "");
+	pthread_mutex_init(&aq->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&aq->avail, &attr);
+	pthread_condattr_destroy(&attr);
+	aq->poolsize = poolsize;
+	aq->qlimit = qlimit;
+
+	pthread_mutex_lock(&registry.lock);
+	if(aq->name[0] != '\0' && FindQueue(aq->name) != NULL) {
+		pthread_mutex_unlock(&registry.lock);
+		pthread_cond_destroy(&aq->avail);
+		pthread_mutex_destroy(&aq->lock);
+		free(aq);
+		return -EEXIST;
+	}
+	aq->nextQueue = registry.list;
+	registry.list = aq;
+	pthread_cond_broadcast(&registry.created);
+	pthread_mutex_unlock(&registry.lock);
+
+	q->obj = aq;
+	return 0;
+}
+
+int rt_queue_delete(RT_QUEUE *q)
+{
+	struct alchemyQueue *aq = q->obj, **pp;
+	struct queueMsg *m;
+
+	if(aq == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&registry.lock);
+	for(pp = &registry.list; *pp != NULL && *pp != aq; pp = &(*pp)->nextQueue);
+	if(*pp != NULL)
+		*pp = aq->nextQueue;
+	pthread_mutex_unlock(&registry.lock);
+
+	while((m = aq->head) != NULL) {
+		aq->head = m->next;
+		free(m);
+	}
+	pthread_cond_destroy(&aq->avail);
+	pthread_mutex_destroy(&aq->lock);
+	free(aq);
+	q->obj = NULL;
+	return 0;
+}
+
+/* Cancellation handlers of the waits below: rt_task_delete() cancels
+ * the task, and pthread_cond_wait() returns to them with the lock held */
+static void UnlockRegistry(void *arg)
+{
+	(void)arg;
+	pthread_mutex_unlock(&registry.lock);
+}
+
+static void StopWaiting(void *arg)
+{
+	struct alchemyQueue *aq = arg;
+
+	aq->waiters--;
+	pthread_mutex_unlock(&aq->lock);
+}
+
+/* Binds to the queue "name", waiting for its creation up to "timeout"
+ * ns (TM_INFINITE: for ever, TM_NONBLOCK: not at all) */
+int rt_queue_bind(RT_QUEUE *q, const char *name, RTIME timeout)
+{
+	struct alchemyQueue *aq;
+	struct timespec deadline = Deadline(CLOCK_REALTIME, timeout);
+	int err = 0;
+
+	pthread_mutex_lock(&registry.lock);
+	pthread_cleanup_push(UnlockRegistry, NULL);
+	while((aq = FindQueue(name)) == NULL && err == 0) {
+		if(timeout == TM_NONBLOCK)
+			err = -EWOULDBLOCK;
+		else if(timeout == TM_INFINITE)
+			pthread_cond_wait(&registry.created, &registry.lock);
+		else if(pthread_cond_timedwait(&registry.created, &registry.lock, &deadline) == ETIMEDOUT)
+			err = -ETIMEDOUT;
+	}
+	pthread_cleanup_pop(1);
+	if(aq != NULL)
+		q->obj = aq;
+	return aq != NULL ? 0 : err;
+}
+
+int rt_queue_unbind(RT_QUEUE *q)
+{
+	q->obj = NULL;
+	return 0;
+}
+
+/* A message buffer, or NULL if the pool of the queue is exhausted */
+void *rt_queue_alloc(RT_QUEUE *q, size_t size)
+{
+	struct alchemyQueue *aq = q->obj;
+	struct queueMsg *m;
+	size_t alloc = sizeof(*m) + size;
+
+	if(aq == NULL)
+		return NULL;
+	pthread_mutex_lock(&aq->lock);
+	if(aq->used + alloc > aq->poolsize) {
+		pthread_mutex_unlock(&aq->lock);
+		return NULL;
+	}
+	aq->used += alloc;
+	pthread_mutex_unlock(&aq->lock);
+
+	m = malloc(alloc);
+	if(m == NULL) {
+		pthread_mutex_lock(&aq->lock);
+		aq->used -= alloc;
+		pthread_mutex_unlock(&aq->lock);
+		return NULL;
+	}
+	m->alloc = alloc;
+	return m->data;
+}
+
+static struct queueMsg *BufMsg(void *buf)
+{
+	return (struct queueMsg *)((char *)buf - offsetof(struct queueMsg, data));
+}
+
+int rt_queue_free(RT_QUEUE *q, void *buf)
+{
+	struct alchemyQueue *aq = q->obj;
+	struct queueMsg *m = BufMsg(buf);
+
+	if(aq == NULL || buf == NULL)
+		return -EINVAL;
+	pthread_mutex_lock(&aq->lock);
+	aq->used -= m->alloc;
+	pthread_mutex_unlock(&aq->lock);
+	free(m);
+	return 0;
+}
+
+/* Queues a buffer from rt_queue_alloc (at the head with Q_URGENT).
+ * Returns the number of receivers woken up (0 or 1) */
+int rt_queue_send(RT_QUEUE *q, const void *buf, size_t size, int mode)
+{
+	struct alchemyQueue *aq = q->obj;
+	struct queueMsg *m = BufMsg((void *)buf);
+	int woken;
+
+	if(aq == NULL || buf == NULL || sizeof(*m) + size > m->alloc)
+		return -EINVAL;
+	m->size = size;
+	pthread_mutex_lock(&aq->lock);
+	if(aq->qlimit != Q_UNLIMITED && aq->count >= aq->qlimit) {
+		pthread_mutex_unlock(&aq->lock);
+		return -ENOMEM;
+	}
+	woken = aq->waiters > 0;
+	if(mode & Q_URGENT) {
+		m->next = aq->head;
+		aq->head = m;
+		if(aq->tail == NULL)
+			aq->tail = m;
+	} else {
+		m->next = NULL;
+		if(aq->tail != NULL)
+			aq->tail->next = m;
+		else
+			aq->head = m;
+		aq->tail = m;
+	}
+	aq->count++;
+	pthread_cond_signal(&aq->avail);
+	pthread_mutex_unlock(&aq->lock);
+	return woken;
+}
+
+/* Dequeues a message, waiting up to "timeout" ns (TM_INFINITE: for
+ * ever, TM_NONBLOCK: not at all). Returns its size */
+ssize_t rt_queue_receive(RT_QUEUE *q, void **bufp, RTIME timeout)
+{
+	struct alchemyQueue *aq = q->obj;
+	struct timespec deadline;
+	struct queueMsg *m;
+	int err;
+
+	if(aq == NULL)
+		return -EINVAL;
+	if(timeout != TM_INFINITE && timeout != TM_NONBLOCK)
+		deadline = Deadline(CLOCK_MONOTONIC, timeout);
+	pthread_mutex_lock(&aq->lock);
+	while((m = aq->head) == NULL) {
+		if(timeout == TM_NONBLOCK) {
+			pthread_mutex_unlock(&aq->lock);
+			return -EWOULDBLOCK;
+		}
+		aq->waiters++;
+		pthread_cleanup_push(StopWaiting, aq);
+		if(timeout == TM_INFINITE)
+			err = pthread_cond_wait(&aq->avail, &aq->lock);
+		else
+			err = pthread_cond_timedwait(&aq->avail, &aq->lock, &deadline);
+		pthread_cleanup_pop(0);
+		aq->waiters--;
+		if(err == ETIMEDOUT && aq->head == NULL) {
+			pthread_mutex_unlock(&aq->lock);
+			return -ETIMEDOUT;
+		}
+	}
+	aq->head = m->next;
+	if(aq->head == NULL)
+		aq->tail = NULL;
+	aq->count--;
+	pthread_mutex_unlock(&aq->lock);
+
+	*bufp = m->data;
+	return m->size;
+}
@@ -0,0 +1,45 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Alchemy message queue API on POSIX threads (BACKEND=posix)
+ *
+ * Queues are found by name (rt_queue_bind) within the process. The
+ * message buffers (rt_queue_alloc) come from malloc, but are limited
+ * to the pool size given to rt_queue_create, as with Xenomai; the
+ * optional limit on queued messages is kept too. Waiters are woken
+ * in FIFO order whatever the mode (Q_PRIO is accepted).
+ *
+ *****************************************************************/
+
+#ifndef ALCHEMY_POSIX_QUEUE_H
+#define ALCHEMY_POSIX_QUEUE_H
+
+#include <stddef.h>
+#include <alchemy/task.h>
+
+#define Q_UNLIMITED 0
+
+/* Creation modes */
+#define Q_FIFO 0x0
+#define Q_PRIO 0x1
+
+/* Send modes */
+#define Q_NORMAL 0x0
+#define Q_URGENT 0x1
+
+struct alchemyQueue;
+
+typedef struct {
+	struct alchemyQueue *obj;
+} RT_QUEUE;
+
+int rt_queue_create(RT_QUEUE *q, const char *name, size_t poolsize, size_t qlimit, int mode);
+int rt_queue_delete(RT_QUEUE *q);
+int rt_queue_bind(RT_QUEUE *q, const char *name, RTIME timeout);
+int rt_queue_unbind(RT_QUEUE *q);
+void *rt_queue_alloc(RT_QUEUE *q, size_t size);
+int rt_queue_free(RT_QUEUE *q, void *buf);
+int rt_queue_send(RT_QUEUE *q, const void *buf, size_t size, int mode);
+ssize_t rt_queue_receive(RT_QUEUE *q, void **bufp, RTIME timeout);
+
+#endif
@@ -0,0 +1,66 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Alchemy task API on POSIX threads (BACKEND=posix, see the Makefile)
+ *
+ * The subset of the Xenomai 3 alchemy skin used by the samples,
+ * with the same prototypes and error codes, so that they build and
+ * run on a stock (or PREEMPT_RT) Linux kernel:
+ *	- tasks are pthreads, SCHED_FIFO at the task priority (0:
+ *	  SCHED_OTHER). Without the privilege for SCHED_FIFO they run as
+ *	  SCHED_OTHER, with a warning
+ *	- periodic tasks sleep with clock_nanosleep(TIMER_ABSTIME) on
+ *	  CLOCK_MONOTONIC. rt_task_wait_period() reports overruns as
+ *	  Xenomai does: -ETIMEDOUT and the number of releases missed,
+ *	  the task continuing from the latest one
+ *
+ * Times (RTIME) are in ns, as with Xenomai's default clock.
+ *
+ *****************************************************************/
+
+#ifndef ALCHEMY_POSIX_TASK_H
+#define ALCHEMY_POSIX_TASK_H
+
+#include <errno.h>
+#include <sched.h>		// cpu_set_t: include with _GNU_SOURCE defined
+#include <sys/types.h>
+
+typedef unsigned long long RTIME;
+typedef long long SRTIME;
+
+#define TM_INFINITE 0
+#define TM_NOW 0
+#define TM_NONBLOCK ((RTIME)-1)
+
+#define XNOBJECT_NAME_LEN 32
+
+/* Task modes */
+#define T_LOCK 0x1			// Accepted, without effect
+#define T_WARNSW 0x2			// Accepted, without effect
+#define T_JOINABLE 0x4
+
+struct alchemyTask;
+
+typedef struct {
+	struct alchemyTask *obj;
+} RT_TASK;
+
+typedef struct {
+	int prio;
+	pid_t pid;
+	char name[XNOBJECT_NAME_LEN];
+} RT_TASK_INFO;
+
+int rt_task_create(RT_TASK *task, const char *name, int stksize, int prio, int mode);
+int rt_task_start(RT_TASK *task, void (*entry)(void *arg), void *arg);
+int rt_task_set_affinity(RT_TASK *task, const cpu_set_t *cpus);
+int rt_task_set_periodic(RT_TASK *task, RTIME idate, RTIME period);
+int rt_task_wait_period(unsigned long *overruns_r);
+RT_TASK *rt_task_self(void);
+int rt_task_inquire(RT_TASK *task, RT_TASK_INFO *info);
+int rt_task_sleep(RTIME delay);
+int rt_task_yield(void);
+int rt_task_join(RT_TASK *task);
+int rt_task_delete(RT_TASK *task);
+
+#endif
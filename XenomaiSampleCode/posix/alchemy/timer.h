@@ -0,0 +1,17 @@
+/******************************************************************
+ * DETI/UA/IT - Real-Time Operating Systems course
+ *
+ * Alchemy timer API on POSIX (BACKEND=posix): CLOCK_MONOTONIC, in ns
+ *
+ *****************************************************************/
+
+#ifndef ALCHEMY_POSIX_TIMER_H
+#define ALCHEMY_POSIX_TIMER_H
+
+#include <alchemy/task.h>
+
+RTIME rt_timer_read(void);
+SRTIME rt_timer_ns2ticks(SRTIME ns);
+SRTIME rt_timer_ticks2ns(SRTIME ticks);
+
+#endif